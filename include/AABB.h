@@ -2,6 +2,7 @@
 
 #include <algorithm>
 
+#include "CpuDispatch.h"
 #include "Ray.h"
 #include "Vec3.h"
 
@@ -34,6 +35,36 @@ struct AABB {
     }
     return true;
   }
+
+  // Slab test with a precomputed reciprocal direction. Unlike the overload
+  // above, zero-thickness boxes (flat, axis-aligned geometry) still hit.
+  // On a hit, *t_enter receives the entry distance.
+  RT_FORCE_INLINE bool Hit(const Ray3& ray, const Vec3& inv_dir, float t_min, float t_max,
+                           float* t_enter = nullptr) const {
+    for (int axis = 0; axis < 3; ++axis) {
+      float origin = ray.origin[axis];
+      if (ray.direction[axis] == 0.0f) {
+        if (origin < min[axis] || origin > max[axis]) {
+          return false;
+        }
+        continue;
+      }
+      float t0 = (min[axis] - origin) * inv_dir[axis];
+      float t1 = (max[axis] - origin) * inv_dir[axis];
+      if (t0 > t1) {
+        std::swap(t0, t1);
+      }
+      t_min = std::max(t_min, t0);
+      t_max = std::min(t_max, t1);
+      if (t_max < t_min) {
+        return false;
+      }
+    }
+    if (t_enter) {
+      *t_enter = t_min;
+    }
+    return true;
+  }
 };
 
 inline AABB SurroundingBox(const AABB& a, const AABB& b) {
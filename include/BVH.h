@@ -1,11 +1,14 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "AABB.h"
 #include "Hittable.h"
+#include "Trace.h"
 
 struct BVHNode : public Hittable {
   HittablePtr left;
@@ -104,3 +107,186 @@ inline HittablePtr BuildBVH(std::vector<HittablePtr>& objects, size_t start, siz
   HittablePtr right = BuildBVH(objects, mid, end);
   return std::make_shared<BVHNode>(left, right);
 }
+
+struct LazyBVH;
+
+// A primitive range of a LazyBVH whose subtree is built by the first ray that
+// reaches its bounds.
+struct LazyBVHNode : public Hittable {
+  const LazyBVH* owner;
+  size_t start;
+  size_t end;
+  AABB bounds;
+  mutable std::once_flag built;
+  mutable HittablePtr subtree;
+
+  LazyBVHNode(const LazyBVH* owner_tree, size_t range_start, size_t range_end);
+
+  bool Hit(const Ray3& ray, float t_min, float t_max, HitRecord& out_hit) const override {
+    if (!bounds.Hit(ray, t_min, t_max)) {
+      return false;
+    }
+    std::call_once(built, [this]() { Build(); });
+    return subtree->Hit(ray, t_min, t_max, out_hit);
+  }
+
+  AABB Bounds() const override {
+    return bounds;
+  }
+
+  Vec3 Centroid() const override {
+    return (bounds.min + bounds.max) * 0.5f;
+  }
+
+ private:
+  void Build() const;
+};
+
+// Interior node above a LazyBVH's ranges. Unlike BVHNode it visits the nearer
+// child first and clips the farther one to the closest hit so far, so a range
+// hidden behind nearer geometry is never built.
+struct LazyBVHTopNode : public Hittable {
+  HittablePtr child[2];
+  AABB child_bounds[2];
+  AABB bounds;
+
+  LazyBVHTopNode(HittablePtr left_node, HittablePtr right_node)
+      : child{std::move(left_node), std::move(right_node)} {
+    child_bounds[0] = child[0]->Bounds();
+    child_bounds[1] = child[1]->Bounds();
+    bounds = SurroundingBox(child_bounds[0], child_bounds[1]);
+  }
+
+  bool Hit(const Ray3& ray, float t_min, float t_max, HitRecord& out_hit) const override {
+    Vec3 inv_dir{1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+    float t_enter[2];
+    bool hit[2];
+    for (int c = 0; c < 2; ++c) {
+      hit[c] = child_bounds[c].Hit(ray, inv_dir, t_min, t_max, &t_enter[c]);
+    }
+    int near = (hit[1] && (!hit[0] || t_enter[1] < t_enter[0])) ? 1 : 0;
+
+    bool hit_any = false;
+    float closest = t_max;
+    for (int c : {near, 1 - near}) {
+      if (hit[c] && t_enter[c] <= closest && child[c]->Hit(ray, t_min, closest, out_hit)) {
+        hit_any = true;
+        closest = out_hit.t;
+      }
+    }
+    return hit_any;
+  }
+
+  AABB Bounds() const override {
+    return bounds;
+  }
+
+  Vec3 Centroid() const override {
+    return (bounds.min + bounds.max) * 0.5f;
+  }
+};
+
+// BVH whose top levels are built up front with median partitions (no full
+// sort) down to ranges of at most lazy_range primitives; each range becomes a
+// LazyBVHNode. Top levels are traversed front to back, so a range is only
+// built once a ray reaches it before hitting anything nearer. objects is
+// not modified after construction: subtrees are built from copies of their
+// range, so it can be read while rendering.
+struct LazyBVH : public Hittable {
+  static constexpr size_t kDefaultLazyRange = 4096;
+
+  std::vector<HittablePtr> objects;
+  HittablePtr root;
+  size_t lazy_subtrees = 0;
+  mutable std::atomic<size_t> built_subtrees{0};
+
+  explicit LazyBVH(std::vector<HittablePtr> primitives, size_t lazy_range = kDefaultLazyRange)
+      : objects(std::move(primitives)) {
+    if (!objects.empty()) {
+      root = BuildTop(0, objects.size(), std::max<size_t>(lazy_range, 2));
+    }
+  }
+
+  LazyBVH(const LazyBVH&) = delete;
+  LazyBVH& operator=(const LazyBVH&) = delete;
+
+  bool Hit(const Ray3& ray, float t_min, float t_max, HitRecord& out_hit) const override {
+    return root && root->Hit(ray, t_min, t_max, out_hit);
+  }
+
+  AABB Bounds() const override {
+    return root ? root->Bounds() : AABB{};
+  }
+
+  Vec3 Centroid() const override {
+    AABB box = Bounds();
+    return (box.min + box.max) * 0.5f;
+  }
+
+ private:
+  HittablePtr BuildTop(size_t start, size_t end, size_t lazy_range) {
+    size_t count = end - start;
+    if (count == 1) {
+      return objects[start];
+    }
+    if (count == 2) {
+      return std::make_shared<BVHNode>(objects[start], objects[start + 1]);
+    }
+    if (count <= lazy_range) {
+      ++lazy_subtrees;
+      return std::make_shared<LazyBVHNode>(this, start, end);
+    }
+
+    Vec3 c0 = objects[start]->Centroid();
+    AABB centroid_bounds;
+    centroid_bounds.min = c0;
+    centroid_bounds.max = c0;
+    for (size_t i = start + 1; i < end; ++i) {
+      Vec3 c = objects[i]->Centroid();
+      centroid_bounds.min.x = std::min(centroid_bounds.min.x, c.x);
+      centroid_bounds.min.y = std::min(centroid_bounds.min.y, c.y);
+      centroid_bounds.min.z = std::min(centroid_bounds.min.z, c.z);
+      centroid_bounds.max.x = std::max(centroid_bounds.max.x, c.x);
+      centroid_bounds.max.y = std::max(centroid_bounds.max.y, c.y);
+      centroid_bounds.max.z = std::max(centroid_bounds.max.z, c.z);
+    }
+
+    // Same split as BuildBVH's sort, in linear time.
+    int axis = LongestAxis(centroid_bounds);
+    size_t mid = start + count / 2;
+    std::nth_element(objects.begin() + static_cast<long>(start), objects.begin() + static_cast<long>(mid),
+                     objects.begin() + static_cast<long>(end),
+                     [axis](const HittablePtr& a, const HittablePtr& b) {
+                       return a->Centroid()[axis] < b->Centroid()[axis];
+                     });
+    HittablePtr left = BuildTop(start, mid, lazy_range);
+    HittablePtr right = BuildTop(mid, end, lazy_range);
+    return std::make_shared<LazyBVHTopNode>(left, right);
+  }
+};
+
+inline LazyBVHNode::LazyBVHNode(const LazyBVH* owner_tree, size_t range_start, size_t range_end)
+    : owner(owner_tree), start(range_start), end(range_end) {
+  bounds = owner->objects[start]->Bounds();
+  for (size_t i = start + 1; i < end; ++i) {
+    bounds = SurroundingBox(bounds, owner->objects[i]->Bounds());
+  }
+}
+
+inline void LazyBVHNode::Build() const {
+  TraceZone zone("lazy_bvh_subtree");
+  std::vector<HittablePtr> range(owner->objects.begin() + static_cast<long>(start),
+                                 owner->objects.begin() + static_cast<long>(end));
+  subtree = BuildBVH(range, 0, range.size());
+  owner->built_subtrees.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Approximate heap footprint of BuildBVH over leaf_count make_shared leaves of
+// leaf_size bytes: one node per interior split, a shared_ptr control block
+// (two counters plus vtable) per allocation, and the input pointer vector.
+inline size_t EstimateBVHBytes(size_t leaf_count, size_t leaf_size) {
+  const size_t control_block = 16;
+  size_t interior = leaf_count > 1 ? leaf_count - 1 : 0;
+  return interior * (sizeof(BVHNode) + control_block) +
+         leaf_count * (leaf_size + control_block + sizeof(HittablePtr));
+}
@@ -6,8 +6,29 @@
 #include "Ray.h"
 #include "Vec3.h"
 
+// Per-frame camera frame; GetRay matches OrbitCamera::GetRay exactly without
+// recomputing the basis for every pixel.
+struct CameraBasis
+{
+    Vec3 position;
+    Vec3 forward;
+    Vec3 right;
+    Vec3 up;
+    float half_width = 1.0f;
+    float half_height = 1.0f;
+
+    Ray3 GetRay(float u, float v) const
+    {
+        Vec3 dir = Normalize(forward + right * (u * half_width) + up * (v * half_height));
+        return Ray3{position, dir};
+    }
+};
+
 struct OrbitCamera
 {
+    // Just short of straight up/down, where the basis would flip.
+    static constexpr float kPitchLimit = 1.4f;
+
     Vec3 target{0.0f, 0.0f, 0.0f};
     float distance = 6.0f;
     float yaw = 0.0f;
@@ -20,8 +41,7 @@ struct OrbitCamera
 
     void ClampTargets()
     {
-        const float pitch_limit = 1.4f;
-        pitch_target = std::clamp(pitch_target, -pitch_limit, pitch_limit);
+        pitch_target = std::clamp(pitch_target, -kPitchLimit, kPitchLimit);
         distance_target = std::clamp(distance_target, 2.0f, 20.0f);
     }
 
@@ -44,18 +64,22 @@ struct OrbitCamera
         };
     }
 
-    Ray3 GetRay(float u, float v, float aspect) const
+    CameraBasis Basis(float aspect) const
     {
-        Vec3 position = Position();
-        Vec3 forward = Normalize(target - position);
-        Vec3 right = Normalize(Cross(forward, Vec3{0.0f, 1.0f, 0.0f}));
-        Vec3 up = Cross(right, forward);
+        CameraBasis basis;
+        basis.position = Position();
+        basis.forward = Normalize(target - basis.position);
+        basis.right = Normalize(Cross(basis.forward, Vec3{0.0f, 1.0f, 0.0f}));
+        basis.up = Cross(basis.right, basis.forward);
 
         float fov_rad = fov_degrees * 0.017453292f;
-        float half_height = std::tan(0.5f * fov_rad);
-        float half_width = aspect * half_height;
+        basis.half_height = std::tan(0.5f * fov_rad);
+        basis.half_width = aspect * basis.half_height;
+        return basis;
+    }
 
-        Vec3 dir = Normalize(forward + right * (u * half_width) + up * (v * half_height));
-        return Ray3{position, dir};
+    Ray3 GetRay(float u, float v, float aspect) const
+    {
+        return Basis(aspect).GetRay(u, v);
     }
 };
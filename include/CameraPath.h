@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "Camera.h"
+
+struct CameraKeyframe
+{
+    float frame = 0.0f;
+    float yaw = 0.0f;
+    float pitch = 0.2f;
+    float distance = 6.0f;
+};
+
+// Keyframed orbit path; frames between keys are linearly interpolated and
+// frames outside the keyed range hold the nearest key. Pitch is clamped like
+// the interactive camera's.
+struct CameraPath
+{
+    std::vector<CameraKeyframe> keys;
+    int frame_count = 0;
+
+    static CameraPath Turntable(int frames, float start_yaw, float pitch, float distance, float revolutions = 1.0f)
+    {
+        CameraPath path;
+        path.frame_count = std::max(1, frames);
+        float end_yaw = start_yaw + revolutions * 6.2831853f;
+        // The closing key sits one frame past the end so the loop doesn't repeat its first frame.
+        path.keys.push_back(CameraKeyframe{0.0f, start_yaw, pitch, distance});
+        path.keys.push_back(CameraKeyframe{static_cast<float>(path.frame_count), end_yaw, pitch, distance});
+        return path;
+    }
+
+    OrbitCamera Evaluate(int frame, const OrbitCamera &base) const
+    {
+        OrbitCamera camera = base;
+        if (keys.empty())
+        {
+            return camera;
+        }
+
+        float f = static_cast<float>(frame);
+        size_t next = 0;
+        while (next < keys.size() && keys[next].frame <= f)
+        {
+            ++next;
+        }
+        const CameraKeyframe &a = keys[next == 0 ? 0 : next - 1];
+        const CameraKeyframe &b = keys[std::min(next, keys.size() - 1)];
+        float span = b.frame - a.frame;
+        float t = span > 0.0f ? std::clamp((f - a.frame) / span, 0.0f, 1.0f) : 0.0f;
+
+        camera.yaw = camera.yaw_target = a.yaw + (b.yaw - a.yaw) * t;
+        float pitch = a.pitch + (b.pitch - a.pitch) * t;
+        camera.pitch = camera.pitch_target = std::clamp(pitch, -OrbitCamera::kPitchLimit, OrbitCamera::kPitchLimit);
+        camera.distance = camera.distance_target = a.distance + (b.distance - a.distance) * t;
+        return camera;
+    }
+};
+
+// Reads "frame yaw pitch distance" lines ('#' starts a comment). The path
+// covers frames 0 through the last key.
+inline bool LoadCameraPath(const char *path, CameraPath &out_path)
+{
+    std::FILE *file = std::fopen(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    out_path = CameraPath{};
+    char line[256];
+    while (std::fgets(line, sizeof(line), file))
+    {
+        CameraKeyframe key;
+        if (line[0] == '#' ||
+            std::sscanf(line, "%f %f %f %f", &key.frame, &key.yaw, &key.pitch, &key.distance) != 4)
+        {
+            continue;
+        }
+        out_path.keys.push_back(key);
+    }
+    std::fclose(file);
+
+    std::sort(out_path.keys.begin(), out_path.keys.end(),
+              [](const CameraKeyframe &a, const CameraKeyframe &b) { return a.frame < b.frame; });
+    if (out_path.keys.empty())
+    {
+        return false;
+    }
+    out_path.frame_count = static_cast<int>(out_path.keys.back().frame) + 1;
+    return true;
+}
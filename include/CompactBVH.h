@@ -0,0 +1,377 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "AABB.h"
+#include "CpuDispatch.h"
+#include "Hittable.h"
+#include "Ray.h"
+#include "Triangle.h"
+#include "Vec3.h"
+
+// Flat BVH for large triangle meshes. Each node stores both children's
+// bounds quantized to 16 bits relative to its own (decoded) box plus two
+// 32-bit child references, 32 bytes in total; boxes are decoded on the fly
+// during traversal. Triangles live in one contiguous array.
+
+struct PackedTriangle
+{
+    Vec3 v0;
+    Vec3 v1;
+    Vec3 v2;
+};
+
+struct CompactBVHNode
+{
+    uint16_t qmin[2][3];
+    uint16_t qmax[2][3];
+    // Interior child: node index. Leaf child: kLeafFlag | (count - 1) << 29 | first triangle.
+    uint32_t child[2];
+};
+
+static_assert(sizeof(CompactBVHNode) == 32);
+
+struct CompactBVH : public Hittable
+{
+    static constexpr uint32_t kLeafFlag = 0x80000000u;
+    static constexpr uint32_t kMaxLeafSize = 4;
+    static constexpr uint32_t kMaxTriangles = 1u << 29;
+    static constexpr float kQuantMax = 65535.0f;
+
+    std::vector<CompactBVHNode> nodes;
+    std::vector<PackedTriangle> triangles;
+    AABB root_bounds;
+
+    CompactBVH() = default;
+
+    // Leaf references hold a 29-bit triangle index.
+    static bool Fits(size_t triangle_count)
+    {
+        return triangle_count <= kMaxTriangles;
+    }
+
+    // positions holds three vertices per triangle.
+    explicit CompactBVH(const std::vector<Vec3> &positions)
+    {
+        Build(positions);
+    }
+
+    // Leaves the BVH empty (and says so) rather than dropping triangles when
+    // the mesh doesn't Fit; callers fall back to the pointer BVH before that.
+    void Build(const std::vector<Vec3> &positions)
+    {
+        nodes.clear();
+        triangles.clear();
+        size_t count = positions.size() / 3;
+        if (!Fits(count))
+        {
+            std::fprintf(stderr, "compact BVH: %zu triangles exceed the limit of %u\n", count, kMaxTriangles);
+            return;
+        }
+        if (count == 0)
+        {
+            return;
+        }
+
+        std::vector<uint32_t> order(count);
+        std::vector<Vec3> centroids(count);
+        root_bounds = TriangleBounds(positions, 0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            order[i] = static_cast<uint32_t>(i);
+            centroids[i] = (positions[i * 3] + positions[i * 3 + 1] + positions[i * 3 + 2]) / 3.0f;
+            root_bounds = SurroundingBox(root_bounds, TriangleBounds(positions, i));
+        }
+
+        nodes.reserve(count / 2 + 1);
+        nodes.emplace_back();
+        BuildNode(0, positions, centroids, order, 0, static_cast<uint32_t>(count), root_bounds);
+
+        triangles.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t src = static_cast<size_t>(order[i]) * 3;
+            triangles[i] = PackedTriangle{positions[src], positions[src + 1], positions[src + 2]};
+        }
+        nodes.shrink_to_fit();
+    }
+
+    size_t MemoryBytes() const
+    {
+        return nodes.capacity() * sizeof(CompactBVHNode) + triangles.capacity() * sizeof(PackedTriangle);
+    }
+
+    bool Hit(const Ray3 &ray, float t_min, float t_max, HitRecord &out_hit) const override
+    {
+#if RT_ISA_DISPATCH
+        if (ActiveCpuIsa() != CpuIsa::Baseline)
+        {
+            return HitAvx2(ray, t_min, t_max, out_hit);
+        }
+#endif
+        return HitImpl(ray, t_min, t_max, out_hit);
+    }
+
+#if RT_ISA_DISPATCH
+    // Traversal is scalar; the AVX-512 encoding measured slower than AVX2
+    // here, so AVX-512 machines use this entry point too.
+    RT_TARGET_AVX2 bool HitAvx2(const Ray3 &ray, float t_min, float t_max, HitRecord &out_hit) const
+    {
+        return HitImpl(ray, t_min, t_max, out_hit);
+    }
+#endif
+
+    // Traversal body shared by the ISA entry points above.
+    RT_FORCE_INLINE bool HitImpl(const Ray3 &ray, float t_min, float t_max, HitRecord &out_hit) const
+    {
+        if (nodes.empty())
+        {
+            return false;
+        }
+
+        Vec3 inv_dir{1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+        if (!root_bounds.Hit(ray, inv_dir, t_min, t_max))
+        {
+            return false;
+        }
+
+        struct StackEntry
+        {
+            uint32_t node;
+            AABB box;
+        };
+        StackEntry stack[64];
+        int stack_size = 0;
+        stack[stack_size++] = StackEntry{0, root_bounds};
+
+        bool hit_any = false;
+        float closest = t_max;
+        while (stack_size > 0)
+        {
+            StackEntry entry = stack[--stack_size];
+            const CompactBVHNode &node = nodes[entry.node];
+
+            AABB child_box[2];
+            float child_t[2];
+            bool child_hit[2];
+            for (int c = 0; c < 2; ++c)
+            {
+                child_box[c] = DecodeChild(entry.box, node, c);
+                child_hit[c] = child_box[c].Hit(ray, inv_dir, t_min, closest, &child_t[c]);
+            }
+
+            // Leaves are intersected right away; interior children are pushed
+            // far-first so the nearer one is popped next.
+            int first = (child_hit[0] && child_hit[1] && child_t[1] < child_t[0]) ? 1 : 0;
+            for (int k = 1; k >= 0; --k)
+            {
+                int c = k == 0 ? first : 1 - first;
+                if (!child_hit[c])
+                {
+                    continue;
+                }
+                uint32_t ref = node.child[c];
+                if (ref & kLeafFlag)
+                {
+                    uint32_t start = ref & (kMaxTriangles - 1);
+                    uint32_t leaf_count = ((ref >> 29) & 3u) + 1;
+                    for (uint32_t i = start; i < start + leaf_count; ++i)
+                    {
+                        if (HitTriangle(triangles[i], ray, t_min, closest, out_hit))
+                        {
+                            hit_any = true;
+                            closest = out_hit.t;
+                        }
+                    }
+                }
+                else if (stack_size < 64)
+                {
+                    stack[stack_size++] = StackEntry{ref, child_box[c]};
+                }
+            }
+        }
+        return hit_any;
+    }
+
+    AABB Bounds() const override
+    {
+        return root_bounds;
+    }
+
+    Vec3 Centroid() const override
+    {
+        return (root_bounds.min + root_bounds.max) * 0.5f;
+    }
+
+    // Minimum is offset up from parent.min, maximum down from parent.max, so
+    // the extreme codes decode to the parent's planes exactly.
+    static AABB DecodeChild(const AABB &parent, const CompactBVHNode &node, int c)
+    {
+        Vec3 scale = (parent.max - parent.min) / kQuantMax;
+        return AABB{
+            Vec3{parent.min.x + static_cast<float>(node.qmin[c][0]) * scale.x,
+                 parent.min.y + static_cast<float>(node.qmin[c][1]) * scale.y,
+                 parent.min.z + static_cast<float>(node.qmin[c][2]) * scale.z},
+            Vec3{parent.max.x - static_cast<float>(65535 - node.qmax[c][0]) * scale.x,
+                 parent.max.y - static_cast<float>(65535 - node.qmax[c][1]) * scale.y,
+                 parent.max.z - static_cast<float>(65535 - node.qmax[c][2]) * scale.z},
+        };
+    }
+
+    // Same arithmetic as Triangle::Hit so both paths produce identical hits.
+    RT_FORCE_INLINE static bool HitTriangle(const PackedTriangle &tri, const Ray3 &ray, float t_min, float t_max, HitRecord &out_hit)
+    {
+        const float kEpsilon = 1e-6f;
+        Vec3 edge1 = tri.v1 - tri.v0;
+        Vec3 edge2 = tri.v2 - tri.v0;
+        Vec3 pvec = Cross(ray.direction, edge2);
+        float det = Dot(edge1, pvec);
+        if (std::abs(det) < kEpsilon)
+        {
+            return false;
+        }
+        float inv_det = 1.0f / det;
+        Vec3 tvec = ray.origin - tri.v0;
+        float u = Dot(tvec, pvec) * inv_det;
+        if (u < 0.0f || u > 1.0f)
+        {
+            return false;
+        }
+        Vec3 qvec = Cross(tvec, edge1);
+        float v = Dot(ray.direction, qvec) * inv_det;
+        if (v < 0.0f || (u + v) > 1.0f)
+        {
+            return false;
+        }
+        float t = Dot(edge2, qvec) * inv_det;
+        if (t < t_min || t > t_max)
+        {
+            return false;
+        }
+
+        out_hit.t = t;
+        out_hit.point = ray.At(t);
+        out_hit.normal = Normalize(Cross(edge1, edge2));
+        return true;
+    }
+
+private:
+    static AABB TriangleBounds(const std::vector<Vec3> &positions, size_t tri)
+    {
+        const Vec3 &a = positions[tri * 3];
+        const Vec3 &b = positions[tri * 3 + 1];
+        const Vec3 &c = positions[tri * 3 + 2];
+        return AABB{
+            Vec3{std::min(a.x, std::min(b.x, c.x)), std::min(a.y, std::min(b.y, c.y)), std::min(a.z, std::min(b.z, c.z))},
+            Vec3{std::max(a.x, std::max(b.x, c.x)), std::max(a.y, std::max(b.y, c.y)), std::max(a.z, std::max(b.z, c.z))},
+        };
+    }
+
+    // Quantizes exact into the frame of parent, widening by one step wherever
+    // float rounding would make the decoded box smaller than the exact one.
+    static void Quantize(const AABB &parent, const AABB &exact, CompactBVHNode &node, int c)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float extent = parent.max[axis] - parent.min[axis];
+            float lo = 0.0f;
+            float hi = 0.0f;
+            if (extent > 0.0f)
+            {
+                lo = std::floor((exact.min[axis] - parent.min[axis]) / extent * kQuantMax);
+                hi = kQuantMax - std::floor((parent.max[axis] - exact.max[axis]) / extent * kQuantMax);
+            }
+            node.qmin[c][axis] = static_cast<uint16_t>(std::clamp(lo, 0.0f, kQuantMax));
+            node.qmax[c][axis] = static_cast<uint16_t>(std::clamp(hi, 0.0f, kQuantMax));
+            if (extent <= 0.0f)
+            {
+                node.qmax[c][axis] = 65535;
+            }
+        }
+
+        for (int pass = 0; pass < 4; ++pass)
+        {
+            AABB decoded = DecodeChild(parent, node, c);
+            bool covered = true;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (decoded.min[axis] > exact.min[axis] && node.qmin[c][axis] > 0)
+                {
+                    --node.qmin[c][axis];
+                    covered = false;
+                }
+                if (decoded.max[axis] < exact.max[axis] && node.qmax[c][axis] < 65535)
+                {
+                    ++node.qmax[c][axis];
+                    covered = false;
+                }
+            }
+            if (covered)
+            {
+                break;
+            }
+        }
+    }
+
+    void BuildNode(uint32_t node_index,
+                   const std::vector<Vec3> &positions,
+                   const std::vector<Vec3> &centroids,
+                   std::vector<uint32_t> &order,
+                   uint32_t start,
+                   uint32_t end,
+                   const AABB &decoded_bounds)
+    {
+        uint32_t count = end - start;
+        uint32_t mid = start + count / 2;
+        if (count > 1)
+        {
+            Vec3 c0 = centroids[order[start]];
+            AABB centroid_bounds{c0, c0};
+            for (uint32_t i = start + 1; i < end; ++i)
+            {
+                const Vec3 &c = centroids[order[i]];
+                centroid_bounds = SurroundingBox(centroid_bounds, AABB{c, c});
+            }
+            Vec3 extent = centroid_bounds.max - centroid_bounds.min;
+            int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+            std::nth_element(order.begin() + start, order.begin() + mid, order.begin() + end,
+                             [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+        }
+        else
+        {
+            // A single triangle: reference the same leaf from both slots.
+            mid = end;
+        }
+
+        uint32_t ranges[2][2] = {{start, mid}, {count > 1 ? mid : start, end}};
+        for (int c = 0; c < 2; ++c)
+        {
+            uint32_t child_start = ranges[c][0];
+            uint32_t child_end = ranges[c][1];
+
+            AABB exact = TriangleBounds(positions, order[child_start]);
+            for (uint32_t i = child_start + 1; i < child_end; ++i)
+            {
+                exact = SurroundingBox(exact, TriangleBounds(positions, order[i]));
+            }
+            Quantize(decoded_bounds, exact, nodes[node_index], c);
+
+            uint32_t child_count = child_end - child_start;
+            if (child_count <= kMaxLeafSize)
+            {
+                nodes[node_index].child[c] = kLeafFlag | ((child_count - 1) << 29) | child_start;
+                continue;
+            }
+
+            AABB child_decoded = DecodeChild(decoded_bounds, nodes[node_index], c);
+            uint32_t child_index = static_cast<uint32_t>(nodes.size());
+            nodes[node_index].child[c] = child_index;
+            nodes.emplace_back();
+            BuildNode(child_index, positions, centroids, order, child_start, child_end, child_decoded);
+        }
+    }
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+// Runtime ISA selection for the hot kernels. Each kernel is a plain inline
+// body plus thin entry points carrying a target attribute; the body is
+// force-inlined into every entry point and compiled once per ISA, while
+// anything left out of line keeps the baseline encoding. The binary itself is
+// built for the baseline ISA, so it runs on any CPU of the architecture.
+//
+// Only GCC/Clang on x86-64 get the AVX2/AVX-512 variants; other targets
+// always run the baseline (SSE2 or NEON) kernels.
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RT_ISA_DISPATCH 1
+#define RT_TARGET_AVX2 __attribute__((target("avx2")))
+#define RT_TARGET_AVX512 __attribute__((target("avx2,avx512f")))
+#else
+#define RT_ISA_DISPATCH 0
+#define RT_TARGET_AVX2
+#define RT_TARGET_AVX512
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RT_FORCE_INLINE inline __attribute__((always_inline))
+#else
+#define RT_FORCE_INLINE __forceinline
+#endif
+
+enum class CpuIsa
+{
+    Baseline = 0,
+    Avx2 = 1,
+    Avx512 = 2,
+};
+
+inline const char *CpuIsaName(CpuIsa isa)
+{
+    switch (isa)
+    {
+    case CpuIsa::Avx2:
+        return "avx2";
+    case CpuIsa::Avx512:
+        return "avx512";
+    default:
+#if defined(__aarch64__) || defined(__ARM_NEON)
+        return "neon";
+#else
+        return "sse2";
+#endif
+    }
+}
+
+inline bool ParseCpuIsa(const char *name, CpuIsa &out_isa)
+{
+    if (!name)
+    {
+        return false;
+    }
+    if (std::strcmp(name, "baseline") == 0 || std::strcmp(name, "sse2") == 0 || std::strcmp(name, "neon") == 0)
+    {
+        out_isa = CpuIsa::Baseline;
+        return true;
+    }
+    if (std::strcmp(name, "avx2") == 0)
+    {
+        out_isa = CpuIsa::Avx2;
+        return true;
+    }
+    if (std::strcmp(name, "avx512") == 0)
+    {
+        out_isa = CpuIsa::Avx512;
+        return true;
+    }
+    return false;
+}
+
+// Best ISA this CPU and OS support (the checks include OS register-state
+// support via XGETBV).
+inline CpuIsa DetectCpuIsa()
+{
+#if RT_ISA_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2"))
+    {
+        return CpuIsa::Avx512;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return CpuIsa::Avx2;
+    }
+#endif
+    return CpuIsa::Baseline;
+}
+
+inline bool CpuIsaSupported(CpuIsa isa)
+{
+    return static_cast<int>(isa) <= static_cast<int>(DetectCpuIsa());
+}
+
+namespace cpu_dispatch_detail
+{
+inline std::atomic<int> &ActiveSlot()
+{
+    static std::atomic<int> slot{[]()
+                                 {
+                                     CpuIsa isa = DetectCpuIsa();
+                                     CpuIsa forced;
+                                     if (ParseCpuIsa(std::getenv("RT_ISA"), forced) && CpuIsaSupported(forced))
+                                     {
+                                         isa = forced;
+                                     }
+                                     return static_cast<int>(isa);
+                                 }()};
+    return slot;
+}
+} // namespace cpu_dispatch_detail
+
+// ISA used by the dispatched kernels: the best supported one, unless the
+// RT_ISA environment variable or SetCpuIsa picks another.
+inline CpuIsa ActiveCpuIsa()
+{
+    return static_cast<CpuIsa>(cpu_dispatch_detail::ActiveSlot().load(std::memory_order_relaxed));
+}
+
+// Forces a kernel variant, e.g. for benchmarking. Returns false (and keeps
+// the current one) if this CPU can't run it.
+inline bool SetCpuIsa(CpuIsa isa)
+{
+    if (!CpuIsaSupported(isa))
+    {
+        return false;
+    }
+    cpu_dispatch_detail::ActiveSlot().store(static_cast<int>(isa), std::memory_order_relaxed);
+    return true;
+}
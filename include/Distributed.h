@@ -0,0 +1,1165 @@
+#pragma once
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "raylib.h"
+
+#include "Camera.h"
+#include "CompactBVH.h"
+#include "Hittable.h"
+#include "MeshAccel.h"
+#include "Renderer.h"
+#include "SphereSet.h"
+#include "Trace.h"
+#include "Triangle.h"
+
+// Coordinator/worker tile rendering over TCP ("host:port") or Unix sockets
+// ("unix:/path"). The coordinator sends the mesh once per mesh version, the
+// camera and RenderParams once per frame, then streams tile requests; workers
+// answer each with the tile's RGBA pixels. Both ends must share endianness.
+
+enum class TileMessage : uint32_t
+{
+    Hello = 1,
+    Scene = 2,
+    Frame = 3,
+    Tile = 4,
+    Result = 5,
+    // Worker refuses a tile request: frame id, tile id, TileReject reason.
+    Reject = 6,
+};
+
+enum class TileReject : uint32_t
+{
+    BadRect = 1,
+    StaleFrame = 2,
+};
+
+constexpr uint32_t kTileProtocolMagic = 0x31545452u; // "RTT1"
+constexpr int kMaxTileSize = 256;
+// Largest accepted payload: a full RGBA tile plus its frame/tile/rect header.
+// Scene messages carry the mesh and get their own, larger limit.
+constexpr uint64_t kMaxMessageBytes = 64 + uint64_t(kMaxTileSize) * kMaxTileSize * sizeof(Color);
+constexpr uint64_t kMaxSceneMessageBytes = uint64_t(1) << 30;
+
+struct WireBuffer
+{
+    std::vector<unsigned char> bytes;
+    size_t read_pos = 0;
+
+    void PutBytes(const void *data, size_t size)
+    {
+        const auto *src = static_cast<const unsigned char *>(data);
+        bytes.insert(bytes.end(), src, src + size);
+    }
+
+    template <typename T>
+    void Put(const T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        PutBytes(&value, sizeof(T));
+    }
+
+    bool GetBytes(void *data, size_t size)
+    {
+        if (bytes.size() - read_pos < size)
+        {
+            return false;
+        }
+        std::memcpy(data, bytes.data() + read_pos, size);
+        read_pos += size;
+        return true;
+    }
+
+    template <typename T>
+    bool Get(T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return GetBytes(&value, sizeof(T));
+    }
+};
+
+inline bool SendAll(int fd, const void *data, size_t size)
+{
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    const auto *src = static_cast<const unsigned char *>(data);
+    while (size > 0)
+    {
+        ssize_t sent = send(fd, src, size, flags);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        src += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+// Waits until fd is readable or deadline passes; a default deadline means
+// no limit.
+inline bool WaitReadable(int fd, std::chrono::steady_clock::time_point deadline)
+{
+    if (deadline == std::chrono::steady_clock::time_point{})
+    {
+        return true;
+    }
+    for (;;)
+    {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0)
+        {
+            return false;
+        }
+        pollfd pfd{fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, static_cast<int>(std::min<int64_t>(left.count(), 1000)));
+        if (ready > 0)
+        {
+            return true;
+        }
+        if (ready < 0 && errno != EINTR)
+        {
+            return false;
+        }
+    }
+}
+
+inline bool RecvAll(int fd, void *data, size_t size, std::chrono::steady_clock::time_point deadline = {})
+{
+    auto *dst = static_cast<unsigned char *>(data);
+    while (size > 0)
+    {
+        if (!WaitReadable(fd, deadline))
+        {
+            return false;
+        }
+        ssize_t got = recv(fd, dst, size, 0);
+        if (got <= 0)
+        {
+            return false;
+        }
+        dst += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+inline bool SendMessage(int fd, TileMessage type, const WireBuffer &payload)
+{
+    uint32_t header_type = static_cast<uint32_t>(type);
+    uint64_t header_size = payload.bytes.size();
+    unsigned char header[12];
+    std::memcpy(header, &header_type, 4);
+    std::memcpy(header + 4, &header_size, 8);
+    return SendAll(fd, header, sizeof(header)) &&
+           SendAll(fd, payload.bytes.data(), payload.bytes.size());
+}
+
+// timeout_seconds bounds the whole message, so a peer that stalls halfway
+// through a frame fails instead of blocking; <= 0 waits indefinitely.
+inline bool RecvMessage(int fd, TileMessage &type, WireBuffer &payload, double timeout_seconds = 0.0)
+{
+    std::chrono::steady_clock::time_point deadline{};
+    if (timeout_seconds > 0.0)
+    {
+        deadline = std::chrono::steady_clock::now() +
+                   std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                       std::chrono::duration<double>(timeout_seconds));
+    }
+    unsigned char header[12];
+    if (!RecvAll(fd, header, sizeof(header), deadline))
+    {
+        return false;
+    }
+    uint32_t header_type = 0;
+    uint64_t header_size = 0;
+    std::memcpy(&header_type, header, 4);
+    std::memcpy(&header_size, header + 4, 8);
+
+    type = static_cast<TileMessage>(header_type);
+    uint64_t limit = type == TileMessage::Scene ? kMaxSceneMessageBytes : kMaxMessageBytes;
+    if (header_size > limit)
+    {
+        std::fprintf(stderr, "tile protocol: %llu-byte message exceeds the %llu-byte limit\n",
+                     static_cast<unsigned long long>(header_size), static_cast<unsigned long long>(limit));
+        return false;
+    }
+    payload.bytes.resize(static_cast<size_t>(header_size));
+    payload.read_pos = 0;
+    return RecvAll(fd, payload.bytes.data(), payload.bytes.size(), deadline);
+}
+
+inline void ConfigureSocket(int fd)
+{
+    int one = 1;
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    // Tile requests are tiny; don't let Nagle hold them back.
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// connect() that gives up after timeout_seconds (<= 0 blocks as usual). The
+// socket is back in blocking mode afterwards.
+inline bool ConnectWithTimeout(int fd, const sockaddr *addr, socklen_t addr_len, double timeout_seconds)
+{
+    if (timeout_seconds <= 0.0)
+    {
+        return connect(fd, addr, addr_len) == 0;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        return false;
+    }
+    bool ok = connect(fd, addr, addr_len) == 0;
+    if (!ok && errno == EINPROGRESS)
+    {
+        pollfd pfd{fd, POLLOUT, 0};
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+        ok = poll(&pfd, 1, static_cast<int>(timeout_seconds * 1000.0)) > 0 &&
+             getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) == 0 && error == 0;
+    }
+    return fcntl(fd, F_SETFL, flags) == 0 && ok;
+}
+
+// Opens a connected (connect_mode) or listening socket for "unix:/path" or
+// "host:port". Returns -1 on failure.
+inline int OpenTileSocket(const std::string &address, bool connect_mode, double connect_timeout_seconds = 0.0)
+{
+    const std::string unix_prefix = "unix:";
+    if (address.compare(0, unix_prefix.size(), unix_prefix) == 0)
+    {
+        std::string path = address.substr(unix_prefix.size());
+        sockaddr_un addr{};
+        if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        {
+            return -1;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        bool ok = false;
+        if (connect_mode)
+        {
+            ok = ConnectWithTimeout(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr), connect_timeout_seconds);
+        }
+        else
+        {
+            unlink(path.c_str());
+            ok = bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0 && listen(fd, 4) == 0;
+        }
+        if (!ok)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos)
+    {
+        return -1;
+    }
+    std::string host = address.substr(0, colon);
+    std::string port = address.substr(colon + 1);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = connect_mode ? 0 : AI_PASSIVE;
+    addrinfo *results = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &results) != 0)
+    {
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo *info = results; info != nullptr; info = info->ai_next)
+    {
+        fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        bool ok = false;
+        if (connect_mode)
+        {
+            ok = ConnectWithTimeout(fd, info->ai_addr, info->ai_addrlen, connect_timeout_seconds);
+        }
+        else
+        {
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            ok = bind(fd, info->ai_addr, info->ai_addrlen) == 0 && listen(fd, 4) == 0;
+        }
+        if (ok)
+        {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(results);
+
+    if (fd >= 0 && connect_mode)
+    {
+        ConfigureSocket(fd);
+    }
+    return fd;
+}
+
+inline std::vector<std::string> SplitAddressList(const std::string &list)
+{
+    std::vector<std::string> addresses;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos)
+        {
+            comma = list.size();
+        }
+        if (comma > start)
+        {
+            addresses.push_back(list.substr(start, comma - start));
+        }
+        start = comma + 1;
+    }
+    return addresses;
+}
+
+inline void PutCamera(WireBuffer &buffer, const OrbitCamera &camera)
+{
+    buffer.Put(camera.target);
+    buffer.Put(camera.distance);
+    buffer.Put(camera.yaw);
+    buffer.Put(camera.pitch);
+    buffer.Put(camera.fov_degrees);
+}
+
+inline bool GetCamera(WireBuffer &buffer, OrbitCamera &camera)
+{
+    return buffer.Get(camera.target) && buffer.Get(camera.distance) && buffer.Get(camera.yaw) &&
+           buffer.Get(camera.pitch) && buffer.Get(camera.fov_degrees);
+}
+
+inline void PutParams(WireBuffer &buffer, const RenderParams &params)
+{
+    buffer.Put(params.sphere.center);
+    buffer.Put(params.sphere.radius);
+    buffer.Put(params.light_position);
+    buffer.Put(params.light_radius);
+    buffer.Put(params.light_intensity);
+    buffer.Put(static_cast<int32_t>(params.shadow_samples));
+    buffer.Put(static_cast<uint8_t>(params.debug_normals ? 1 : 0));
+    buffer.Put(params.albedo);
+    buffer.Put(params.roughness);
+    buffer.Put(params.metallic);
+}
+
+inline bool GetParams(WireBuffer &buffer, RenderParams &params)
+{
+    int32_t samples = 0;
+    uint8_t debug = 0;
+    bool ok = buffer.Get(params.sphere.center) && buffer.Get(params.sphere.radius) &&
+              buffer.Get(params.light_position) && buffer.Get(params.light_radius) &&
+              buffer.Get(params.light_intensity) && buffer.Get(samples) && buffer.Get(debug) &&
+              buffer.Get(params.albedo) && buffer.Get(params.roughness) && buffer.Get(params.metallic);
+    params.shadow_samples = samples;
+    params.debug_normals = debug != 0;
+    return ok;
+}
+
+// The mesh cache holds the triangles and sphere-set spheres of the extra
+// objects; any other primitive types are not shipped.
+inline void PutMesh(WireBuffer &buffer, const std::vector<HittablePtr> &objects)
+{
+    std::vector<Vec3> positions;
+    CollectTrianglePositions(objects, positions);
+    std::vector<SphereInstance> spheres;
+    CollectSpheres(objects, spheres);
+
+    uint64_t triangle_count = positions.size() / 3;
+    uint64_t sphere_count = spheres.size();
+    buffer.bytes.reserve(buffer.bytes.size() + 2 * sizeof(uint64_t) + positions.size() * sizeof(Vec3) +
+                         spheres.size() * sizeof(SphereInstance));
+    buffer.Put(triangle_count);
+    buffer.PutBytes(positions.data(), positions.size() * sizeof(Vec3));
+    buffer.Put(sphere_count);
+    buffer.PutBytes(spheres.data(), spheres.size() * sizeof(SphereInstance));
+}
+
+// Workers keep the mesh cache as one CompactBVH plus one SphereSet.
+inline bool GetMesh(WireBuffer &buffer, std::vector<HittablePtr> &objects)
+{
+    uint64_t triangle_count = 0;
+    if (!buffer.Get(triangle_count) ||
+        triangle_count > (buffer.bytes.size() - buffer.read_pos) / (sizeof(Vec3) * 3))
+    {
+        return false;
+    }
+    std::vector<Vec3> positions(static_cast<size_t>(triangle_count) * 3);
+    buffer.GetBytes(positions.data(), positions.size() * sizeof(Vec3));
+
+    uint64_t sphere_count = 0;
+    if (!buffer.Get(sphere_count) ||
+        sphere_count > (buffer.bytes.size() - buffer.read_pos) / sizeof(SphereInstance))
+    {
+        return false;
+    }
+    std::vector<SphereInstance> spheres(static_cast<size_t>(sphere_count));
+    buffer.GetBytes(spheres.data(), spheres.size() * sizeof(SphereInstance));
+
+    objects.clear();
+    if (triangle_count > 0)
+    {
+        AppendCompactMesh(positions, objects);
+    }
+    if (sphere_count > 0)
+    {
+        objects.push_back(std::make_shared<SphereSet>(std::move(spheres)));
+    }
+    return true;
+}
+
+struct TileRect
+{
+    int x0 = 0;
+    int y0 = 0;
+    int x1 = 0;
+    int y1 = 0;
+};
+
+inline std::vector<TileRect> SplitIntoTiles(int width, int height, int tile_size)
+{
+    std::vector<TileRect> tiles;
+    tile_size = std::clamp(tile_size, 8, kMaxTileSize);
+    for (int y = 0; y < height; y += tile_size)
+    {
+        for (int x = 0; x < width; x += tile_size)
+        {
+            tiles.push_back(TileRect{x, y, std::min(width, x + tile_size), std::min(height, y + tile_size)});
+        }
+    }
+    return tiles;
+}
+
+struct TileFrameState
+{
+    uint32_t frame_id = 0;
+    int width = 0;
+    int height = 0;
+    OrbitCamera camera;
+    RenderParams params;
+    HittablePtr root;
+};
+
+// Serves one coordinator connection until it closes. Tiles are rendered by
+// thread_count pool threads; the calling thread only reads messages.
+inline void ServeTileConnection(int fd, unsigned int thread_count)
+{
+    WireBuffer hello;
+    hello.Put(kTileProtocolMagic);
+    hello.Put(static_cast<uint32_t>(thread_count));
+    if (!SendMessage(fd, TileMessage::Hello, hello))
+    {
+        return;
+    }
+
+    struct TileJob
+    {
+        std::shared_ptr<const TileFrameState> frame;
+        uint32_t tile_id = 0;
+        TileRect rect;
+    };
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<TileJob> jobs;
+    bool stopping = false;
+    std::mutex send_mutex;
+
+    auto pool_loop = [&]()
+    {
+        std::vector<Color> tile_pixels;
+        for (;;)
+        {
+            TileJob job;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_cv.wait(lock, [&]() { return stopping || !jobs.empty(); });
+                if (stopping)
+                {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            const TileRect &r = job.rect;
+            int tile_w = r.x1 - r.x0;
+            tile_pixels.resize(static_cast<size_t>(tile_w * (r.y1 - r.y0)));
+            RenderTile(tile_pixels.data(), tile_w, job.frame->width, job.frame->height,
+                       r.x0, r.y0, r.x1, r.y1, job.frame->camera, job.frame->params, *job.frame->root);
+
+            WireBuffer result;
+            result.bytes.reserve(32 + tile_pixels.size() * sizeof(Color));
+            result.Put(job.frame->frame_id);
+            result.Put(job.tile_id);
+            result.Put(r);
+            result.PutBytes(tile_pixels.data(), tile_pixels.size() * sizeof(Color));
+
+            std::lock_guard<std::mutex> lock(send_mutex);
+            SendMessage(fd, TileMessage::Result, result);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(thread_count);
+    for (unsigned int i = 0; i < thread_count; ++i)
+    {
+        pool.emplace_back(pool_loop);
+    }
+
+    std::vector<HittablePtr> mesh_objects;
+    bool mesh_changed = true;
+    std::shared_ptr<const TileFrameState> current;
+
+    TileMessage type{};
+    WireBuffer message;
+    while (RecvMessage(fd, type, message))
+    {
+        if (type == TileMessage::Scene)
+        {
+            if (!GetMesh(message, mesh_objects))
+            {
+                break;
+            }
+            mesh_changed = true;
+        }
+        else if (type == TileMessage::Frame)
+        {
+            auto frame = std::make_shared<TileFrameState>();
+            int32_t width = 0;
+            int32_t height = 0;
+            if (!message.Get(frame->frame_id) || !message.Get(width) || !message.Get(height) ||
+                !GetCamera(message, frame->camera) || !GetParams(message, frame->params))
+            {
+                break;
+            }
+            frame->width = width;
+            frame->height = height;
+
+            // The BVH only depends on the sphere and the mesh; reuse it otherwise.
+            bool same_geometry = current && !mesh_changed &&
+                                 current->params.sphere.center.x == frame->params.sphere.center.x &&
+                                 current->params.sphere.center.y == frame->params.sphere.center.y &&
+                                 current->params.sphere.center.z == frame->params.sphere.center.z &&
+                                 current->params.sphere.radius == frame->params.sphere.radius;
+            frame->root = same_geometry ? current->root : BuildSceneBVH(frame->params, mesh_objects);
+            mesh_changed = false;
+            current = frame;
+        }
+        else if (type == TileMessage::Tile)
+        {
+            TileJob job;
+            uint32_t frame_id = 0;
+            if (!message.Get(frame_id) || !message.Get(job.tile_id) || !message.Get(job.rect))
+            {
+                break;
+            }
+            auto reject = [&](TileReject reason)
+            {
+                WireBuffer reply;
+                reply.Put(frame_id);
+                reply.Put(job.tile_id);
+                reply.Put(static_cast<uint32_t>(reason));
+                std::lock_guard<std::mutex> lock(send_mutex);
+                return SendMessage(fd, TileMessage::Reject, reply);
+            };
+            if (!current || current->frame_id != frame_id)
+            {
+                if (!reject(TileReject::StaleFrame))
+                {
+                    break;
+                }
+                continue;
+            }
+            const TileRect &r = job.rect;
+            if (r.x0 < 0 || r.y0 < 0 || r.x1 <= r.x0 || r.y1 <= r.y0 || r.x1 > current->width ||
+                r.y1 > current->height || r.x1 - r.x0 > kMaxTileSize || r.y1 - r.y0 > kMaxTileSize)
+            {
+                if (!reject(TileReject::BadRect))
+                {
+                    break;
+                }
+                continue;
+            }
+            job.frame = current;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                jobs.push_back(std::move(job));
+            }
+            queue_cv.notify_one();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    for (auto &thread : pool)
+    {
+        thread.join();
+    }
+}
+
+// Headless worker entry point. Serves one coordinator at a time: a worker's
+// threads all go to the connected coordinator, and the next one is accepted
+// only after it disconnects. A second coordinator meanwhile waits in the
+// listen backlog without a Hello, so its Connect times out and it treats
+// the worker as unavailable.
+inline int RunTileWorker(const std::string &address, unsigned int thread_count)
+{
+    int listen_fd = OpenTileSocket(address, false);
+    if (listen_fd < 0)
+    {
+        std::fprintf(stderr, "worker: cannot listen on %s\n", address.c_str());
+        return 1;
+    }
+
+    thread_count = std::max(1u, thread_count);
+    std::printf("worker: listening on %s with %u threads\n", address.c_str(), thread_count);
+    std::fflush(stdout);
+
+    for (;;)
+    {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            continue;
+        }
+        ConfigureSocket(fd);
+        ServeTileConnection(fd, thread_count);
+        close(fd);
+    }
+}
+
+struct TileWorkerLink
+{
+    struct InFlight
+    {
+        uint32_t frame_id = 0;
+        uint32_t tile_id = 0;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    std::string address;
+    int fd = -1;
+    unsigned int threads = 1;
+    bool has_mesh = false;
+    uint64_t mesh_version = 0;
+    std::vector<InFlight> in_flight;
+    // Timeline row for this worker's tiles, looked up on the first traced tile.
+    TraceRing *trace_ring = nullptr;
+};
+
+struct TileCoordinator
+{
+    using Clock = std::chrono::steady_clock;
+
+    int tile_size = 64;
+    // A tile becomes a straggler once it runs this many times the average
+    // tile time; idle workers then get a duplicate and the first result wins.
+    double straggler_factor = 4.0;
+    double min_straggler_seconds = 0.25;
+    // A worker that sits on a tile this long is considered dead.
+    double worker_timeout_seconds = 10.0;
+    // Once a worker's message has started arriving, the rest must follow
+    // within this time.
+    double message_timeout_seconds = 2.0;
+    // Connect runs on the UI thread; an unreachable worker costs at most this
+    // much for the connect plus as much again for its Hello.
+    double connect_timeout_seconds = 2.0;
+
+    std::vector<TileWorkerLink> workers;
+    uint32_t frame_id = 0;
+    int tiles_reissued = 0;
+    int tiles_rendered_locally = 0;
+
+    TileCoordinator() = default;
+    TileCoordinator(const TileCoordinator &) = delete;
+    TileCoordinator &operator=(const TileCoordinator &) = delete;
+
+    ~TileCoordinator()
+    {
+        Disconnect();
+    }
+
+    size_t Connect(const std::vector<std::string> &addresses)
+    {
+        Disconnect();
+        for (const auto &address : addresses)
+        {
+            TileWorkerLink link;
+            link.address = address;
+            link.fd = OpenTileSocket(address, true, connect_timeout_seconds);
+
+            TileMessage type{};
+            WireBuffer hello;
+            uint32_t magic = 0;
+            uint32_t threads = 0;
+            if (link.fd >= 0 &&
+                (!RecvMessage(link.fd, type, hello, connect_timeout_seconds) || type != TileMessage::Hello ||
+                 !hello.Get(magic) || !hello.Get(threads) || magic != kTileProtocolMagic))
+            {
+                close(link.fd);
+                link.fd = -1;
+            }
+            link.threads = std::max(1u, threads);
+            workers.push_back(std::move(link));
+        }
+        return AliveWorkers();
+    }
+
+    void Disconnect()
+    {
+        for (auto &link : workers)
+        {
+            if (link.fd >= 0)
+            {
+                close(link.fd);
+            }
+        }
+        workers.clear();
+    }
+
+    size_t AliveWorkers() const
+    {
+        return static_cast<size_t>(std::count_if(workers.begin(), workers.end(),
+                                                 [](const TileWorkerLink &link) { return link.fd >= 0; }));
+    }
+
+    // Renders a full frame on the connected workers. Tiles of workers that
+    // drop out are re-queued; if every worker is gone the rest is rendered
+    // locally. Returns false (without touching pixels) if no worker is alive.
+    bool RenderFrame(std::vector<Color> &pixels,
+                     int width,
+                     int height,
+                     const OrbitCamera &camera,
+                     const RenderParams &params,
+                     const std::vector<HittablePtr> &extra_objects,
+                     uint64_t mesh_version,
+                     unsigned int local_threads)
+    {
+        if (width <= 0 || height <= 0 || AliveWorkers() == 0)
+        {
+            return false;
+        }
+
+        TraceZone zone("distributed_frame");
+        pixels.resize(static_cast<size_t>(width * height));
+        ++frame_id;
+
+        std::vector<TileRect> tiles = SplitIntoTiles(width, height, tile_size);
+        std::vector<unsigned char> done(tiles.size(), 0);
+        std::vector<unsigned char> issued(tiles.size(), 0);
+        std::deque<uint32_t> pending;
+        for (uint32_t i = 0; i < tiles.size(); ++i)
+        {
+            pending.push_back(i);
+        }
+        size_t remaining = tiles.size();
+
+        WireBuffer frame_msg;
+        frame_msg.Put(frame_id);
+        frame_msg.Put(static_cast<int32_t>(width));
+        frame_msg.Put(static_cast<int32_t>(height));
+        PutCamera(frame_msg, camera);
+        PutParams(frame_msg, params);
+
+        WireBuffer mesh_msg;
+        bool mesh_encoded = false;
+        for (auto &link : workers)
+        {
+            if (link.fd < 0)
+            {
+                continue;
+            }
+            // Leftovers from earlier frames (duplicated stragglers, rejected
+            // tiles) must not hold capacity or trip the hung-worker timeout;
+            // their late replies are ignored by frame id.
+            link.in_flight.clear();
+            if (!link.has_mesh || link.mesh_version != mesh_version)
+            {
+                if (!mesh_encoded)
+                {
+                    PutMesh(mesh_msg, extra_objects);
+                    mesh_encoded = true;
+                }
+                if (!SendMessage(link.fd, TileMessage::Scene, mesh_msg))
+                {
+                    DropWorker(link, done, pending);
+                    continue;
+                }
+                link.has_mesh = true;
+                link.mesh_version = mesh_version;
+            }
+            if (!SendMessage(link.fd, TileMessage::Frame, frame_msg))
+            {
+                DropWorker(link, done, pending);
+            }
+        }
+
+        double average_tile_seconds = 0.0;
+        int completed_samples = 0;
+        std::vector<pollfd> poll_fds;
+        std::vector<TileWorkerLink *> poll_links;
+        WireBuffer message;
+
+        while (remaining > 0)
+        {
+            if (AliveWorkers() == 0)
+            {
+                RenderRemainingLocally(pixels, width, height, camera, params, extra_objects,
+                                       tiles, done, local_threads);
+                break;
+            }
+
+            Clock::time_point now = Clock::now();
+            double straggler_seconds = std::max(min_straggler_seconds, straggler_factor * average_tile_seconds);
+
+            for (auto &link : workers)
+            {
+                if (link.fd < 0)
+                {
+                    continue;
+                }
+                bool timed_out = std::any_of(link.in_flight.begin(), link.in_flight.end(),
+                                             [&](const TileWorkerLink::InFlight &f)
+                                             {
+                                                 return std::chrono::duration<double>(now - f.started).count() >
+                                                        worker_timeout_seconds;
+                                             });
+                if (timed_out)
+                {
+                    std::fprintf(stderr, "coordinator: worker %s timed out\n", link.address.c_str());
+                    DropWorker(link, done, pending);
+                    continue;
+                }
+
+                size_t capacity = static_cast<size_t>(link.threads) * 2;
+                while (link.in_flight.size() < capacity)
+                {
+                    int tile = NextTile(link, pending, done, now, straggler_seconds, issued);
+                    if (tile < 0)
+                    {
+                        break;
+                    }
+                    WireBuffer request;
+                    request.Put(frame_id);
+                    request.Put(static_cast<uint32_t>(tile));
+                    request.Put(tiles[static_cast<size_t>(tile)]);
+                    if (!SendMessage(link.fd, TileMessage::Tile, request))
+                    {
+                        pending.push_front(static_cast<uint32_t>(tile));
+                        DropWorker(link, done, pending);
+                        break;
+                    }
+                    issued[static_cast<size_t>(tile)] += 1;
+                    link.in_flight.push_back(TileWorkerLink::InFlight{frame_id, static_cast<uint32_t>(tile), now});
+                }
+            }
+
+            poll_fds.clear();
+            poll_links.clear();
+            for (auto &link : workers)
+            {
+                if (link.fd >= 0)
+                {
+                    poll_fds.push_back(pollfd{link.fd, POLLIN, 0});
+                    poll_links.push_back(&link);
+                }
+            }
+            if (poll_fds.empty())
+            {
+                continue;
+            }
+            if (poll(poll_fds.data(), static_cast<nfds_t>(poll_fds.size()), 20) <= 0)
+            {
+                continue;
+            }
+
+            for (size_t i = 0; i < poll_fds.size(); ++i)
+            {
+                if (poll_fds[i].revents == 0)
+                {
+                    continue;
+                }
+                TileWorkerLink &link = *poll_links[i];
+                TileMessage type{};
+                uint32_t result_frame = 0;
+                uint32_t tile = 0;
+                TileRect rect;
+                if (!RecvMessage(link.fd, type, message, message_timeout_seconds) ||
+                    (type != TileMessage::Result && type != TileMessage::Reject) ||
+                    !message.Get(result_frame) || !message.Get(tile))
+                {
+                    std::fprintf(stderr, "coordinator: lost worker %s\n", link.address.c_str());
+                    DropWorker(link, done, pending);
+                    continue;
+                }
+                if (type == TileMessage::Reject)
+                {
+                    HandleReject(link, result_frame, tile, message, done, pending);
+                    continue;
+                }
+                if (!message.Get(rect))
+                {
+                    std::fprintf(stderr, "coordinator: lost worker %s\n", link.address.c_str());
+                    DropWorker(link, done, pending);
+                    continue;
+                }
+
+                // A malformed current-frame result is a protocol error: dropping
+                // the worker while the tile is still in flight re-queues it.
+                size_t row_bytes = 0;
+                if (result_frame == frame_id)
+                {
+                    bool valid = tile < tiles.size();
+                    if (valid)
+                    {
+                        const TileRect &expected = tiles[tile];
+                        row_bytes = static_cast<size_t>(expected.x1 - expected.x0) * sizeof(Color);
+                        valid = std::memcmp(&rect, &expected, sizeof(TileRect)) == 0 &&
+                                message.bytes.size() - message.read_pos ==
+                                    row_bytes * static_cast<size_t>(expected.y1 - expected.y0);
+                    }
+                    if (!valid)
+                    {
+                        std::fprintf(stderr, "coordinator: bad result from worker %s\n", link.address.c_str());
+                        DropWorker(link, done, pending);
+                        continue;
+                    }
+                }
+
+                auto it = std::find_if(link.in_flight.begin(), link.in_flight.end(),
+                                       [&](const TileWorkerLink::InFlight &f)
+                                       { return f.frame_id == result_frame && f.tile_id == tile; });
+                if (it != link.in_flight.end())
+                {
+                    if (Tracer::Get().Enabled())
+                    {
+                        Tracer &tracer = Tracer::Get();
+                        int64_t start_ns = tracer.ToNs(it->started);
+                        if (!link.trace_ring)
+                        {
+                            link.trace_ring = &tracer.NamedRing("worker " + link.address);
+                        }
+                        link.trace_ring->Push(TraceEvent{"tile", start_ns, tracer.NowNs() - start_ns});
+                    }
+                    if (result_frame == frame_id)
+                    {
+                        double seconds = std::chrono::duration<double>(Clock::now() - it->started).count();
+                        ++completed_samples;
+                        average_tile_seconds += (seconds - average_tile_seconds) / completed_samples;
+                    }
+                    link.in_flight.erase(it);
+                }
+
+                if (result_frame != frame_id || done[tile])
+                {
+                    continue;
+                }
+                const TileRect &expected = tiles[tile];
+                for (int y = expected.y0; y < expected.y1; ++y)
+                {
+                    message.GetBytes(pixels.data() + static_cast<size_t>(y * width + expected.x0), row_bytes);
+                }
+                done[tile] = 1;
+                --remaining;
+            }
+        }
+
+        return true;
+    }
+
+private:
+    // A rejected tile from an earlier frame only frees its slot. Rejecting a
+    // current-frame tile means the worker disagrees about the frame itself,
+    // so it is dropped and its tiles re-queued rather than retried forever.
+    void HandleReject(TileWorkerLink &link,
+                      uint32_t reject_frame,
+                      uint32_t tile,
+                      WireBuffer &message,
+                      const std::vector<unsigned char> &done,
+                      std::deque<uint32_t> &pending)
+    {
+        uint32_t reason = 0;
+        message.Get(reason);
+        if (reject_frame == frame_id)
+        {
+            std::fprintf(stderr, "coordinator: worker %s rejected tile %u (reason %u)\n",
+                         link.address.c_str(), tile, reason);
+            DropWorker(link, done, pending);
+            return;
+        }
+        auto it = std::find_if(link.in_flight.begin(), link.in_flight.end(),
+                               [&](const TileWorkerLink::InFlight &f)
+                               { return f.frame_id == reject_frame && f.tile_id == tile; });
+        if (it != link.in_flight.end())
+        {
+            link.in_flight.erase(it);
+        }
+    }
+
+    void DropWorker(TileWorkerLink &link, const std::vector<unsigned char> &done, std::deque<uint32_t> &pending)
+    {
+        for (const auto &f : link.in_flight)
+        {
+            if (f.frame_id == frame_id && !done[f.tile_id])
+            {
+                pending.push_front(f.tile_id);
+            }
+        }
+        link.in_flight.clear();
+        if (link.fd >= 0)
+        {
+            close(link.fd);
+            link.fd = -1;
+        }
+    }
+
+    int NextTile(const TileWorkerLink &requester,
+                 std::deque<uint32_t> &pending,
+                 const std::vector<unsigned char> &done,
+                 Clock::time_point now,
+                 double straggler_seconds,
+                 const std::vector<unsigned char> &issued)
+    {
+        while (!pending.empty())
+        {
+            uint32_t tile = pending.front();
+            pending.pop_front();
+            if (!done[tile])
+            {
+                return static_cast<int>(tile);
+            }
+        }
+
+        // Queue drained: duplicate the oldest straggler that hasn't been re-issued yet.
+        const TileWorkerLink::InFlight *oldest = nullptr;
+        for (const auto &link : workers)
+        {
+            if (&link == &requester)
+            {
+                continue;
+            }
+            for (const auto &f : link.in_flight)
+            {
+                if (f.frame_id != frame_id || done[f.tile_id] || issued[f.tile_id] > 1)
+                {
+                    continue;
+                }
+                if (std::chrono::duration<double>(now - f.started).count() > straggler_seconds &&
+                    (!oldest || f.started < oldest->started))
+                {
+                    oldest = &f;
+                }
+            }
+        }
+        if (!oldest)
+        {
+            return -1;
+        }
+        ++tiles_reissued;
+        return static_cast<int>(oldest->tile_id);
+    }
+
+    void RenderRemainingLocally(std::vector<Color> &pixels,
+                                int width,
+                                int height,
+                                const OrbitCamera &camera,
+                                const RenderParams &params,
+                                const std::vector<HittablePtr> &extra_objects,
+                                const std::vector<TileRect> &tiles,
+                                std::vector<unsigned char> &done,
+                                unsigned int thread_count)
+    {
+        std::vector<uint32_t> leftover;
+        for (uint32_t i = 0; i < tiles.size(); ++i)
+        {
+            if (!done[i])
+            {
+                leftover.push_back(i);
+                done[i] = 1;
+            }
+        }
+        tiles_rendered_locally += static_cast<int>(leftover.size());
+
+        HittablePtr bvh_root;
+        {
+            TraceZone zone("BuildSceneBVH");
+            bvh_root = BuildSceneBVH(params, extra_objects);
+        }
+        std::atomic<size_t> next{0};
+        auto render_tiles = [&]()
+        {
+            TraceThreadName("render");
+            TraceZone zone("local_tiles");
+            for (size_t i = next++; i < leftover.size(); i = next++)
+            {
+                const TileRect &r = tiles[leftover[i]];
+                RenderTile(pixels.data() + static_cast<size_t>(r.y0 * width + r.x0), width,
+                           width, height, r.x0, r.y0, r.x1, r.y1, camera, params, *bvh_root);
+            }
+        };
+
+        std::vector<std::thread> local_workers;
+        thread_count = std::max(1u, thread_count);
+        for (unsigned int i = 0; i < thread_count; ++i)
+        {
+            local_workers.emplace_back(render_tiles);
+        }
+        for (auto &worker : local_workers)
+        {
+            worker.join();
+        }
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "BVH.h"
+#include "CompactBVH.h"
+#include "Hittable.h"
+#include "Triangle.h"
+#include "Vec3.h"
+
+// The acceleration structures a loaded mesh can use, and helpers that work
+// across all of them.
+
+enum class MeshAccel
+{
+    Pointer = 0,
+    Compact = 1,
+    Lazy = 2,
+};
+
+// Combo entries in MeshAccel order.
+constexpr const char *kMeshAccelComboItems = "Pointer BVH\0Compact BVH (16-bit)\0Lazy Pointer BVH\0";
+
+inline bool MeshAccelFromIndex(int index, MeshAccel &out_accel)
+{
+    switch (index)
+    {
+    case 0:
+        out_accel = MeshAccel::Pointer;
+        return true;
+    case 1:
+        out_accel = MeshAccel::Compact;
+        return true;
+    case 2:
+        out_accel = MeshAccel::Lazy;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// One Triangle per three positions, for the scene's pointer BVH to be built over.
+inline std::vector<HittablePtr> MakeTriangles(const std::vector<Vec3> &positions)
+{
+    std::vector<HittablePtr> triangles;
+    triangles.reserve(positions.size() / 3);
+    for (size_t i = 0; i + 2 < positions.size(); i += 3)
+    {
+        auto tri = std::make_shared<Triangle>();
+        tri->v0 = positions[i];
+        tri->v1 = positions[i + 1];
+        tri->v2 = positions[i + 2];
+        triangles.push_back(tri);
+    }
+    return triangles;
+}
+
+// Adds positions as one CompactBVH, or as plain triangles when the mesh is
+// too large for the compact format.
+inline void AppendCompactMesh(const std::vector<Vec3> &positions, std::vector<HittablePtr> &objects)
+{
+    if (CompactBVH::Fits(positions.size() / 3))
+    {
+        objects.push_back(std::make_shared<CompactBVH>(positions));
+        return;
+    }
+    std::fprintf(stderr, "mesh has %zu triangles, too many for the compact BVH; using the pointer BVH\n",
+                 positions.size() / 3);
+    std::vector<HittablePtr> triangles = MakeTriangles(positions);
+    objects.insert(objects.end(), triangles.begin(), triangles.end());
+}
+
+// Appends three vertices per triangle found in objects (plain triangles,
+// compact meshes and lazy BVHs over triangles); other primitives are skipped.
+inline void CollectTrianglePositions(const std::vector<HittablePtr> &objects, std::vector<Vec3> &out_positions)
+{
+    for (const auto &obj : objects)
+    {
+        if (const auto *tri = dynamic_cast<const Triangle *>(obj.get()))
+        {
+            out_positions.push_back(tri->v0);
+            out_positions.push_back(tri->v1);
+            out_positions.push_back(tri->v2);
+        }
+        else if (const auto *mesh = dynamic_cast<const CompactBVH *>(obj.get()))
+        {
+            for (const auto &packed : mesh->triangles)
+            {
+                out_positions.push_back(packed.v0);
+                out_positions.push_back(packed.v1);
+                out_positions.push_back(packed.v2);
+            }
+        }
+        else if (const auto *lazy = dynamic_cast<const LazyBVH *>(obj.get()))
+        {
+            CollectTrianglePositions(lazy->objects, out_positions);
+        }
+    }
+}
@@ -4,12 +4,13 @@
 
 #include "raylib.h"
 
-#include "Triangle.h"
+#include "Vec3.h"
 
-inline bool LoadObjAsTriangles(const char *path,
-                               const Vec3 &offset,
-                               float scale,
-                               std::vector<HittablePtr> &out_objects)
+// Appends three transformed vertices per triangle to out_positions.
+inline bool LoadObjPositions(const char *path,
+                             const Vec3 &offset,
+                             float scale,
+                             std::vector<Vec3> &out_positions)
 {
     if (!FileExists(path))
     {
@@ -53,11 +54,9 @@ inline bool LoadObjAsTriangles(const char *path,
             v1 = v1 * scale + offset;
             v2 = v2 * scale + offset;
 
-            auto tri_obj = std::make_shared<Triangle>();
-            tri_obj->v0 = v0;
-            tri_obj->v1 = v1;
-            tri_obj->v2 = v2;
-            out_objects.push_back(tri_obj);
+            out_positions.push_back(v0);
+            out_positions.push_back(v1);
+            out_positions.push_back(v2);
         }
     }
 
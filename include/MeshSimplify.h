@@ -0,0 +1,614 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include "BVH.h"
+#include "CompactBVH.h"
+#include "Hittable.h"
+#include "MeshAccel.h"
+#include "Triangle.h"
+#include "Vec3.h"
+
+// Mesh simplification by edge collapse with quadric error metrics (Garland
+// and Heckbert). Each vertex carries the sum of the squared-distance
+// quadrics of its faces; the cheapest edge is collapsed to the point that
+// minimizes the summed quadric, until the target triangle count is reached.
+// Collapses that would flip a face or pinch the surface are skipped, and
+// open borders get an extra perpendicular quadric so silhouettes hold.
+
+struct IndexedMesh
+{
+    std::vector<Vec3> vertices;
+    std::vector<uint32_t> indices;
+
+    size_t TriangleCount() const
+    {
+        return indices.size() / 3;
+    }
+};
+
+// Merges bit-identical positions; positions holds three vertices per triangle.
+inline IndexedMesh WeldTriangles(const std::vector<Vec3> &positions)
+{
+    struct Key
+    {
+        uint32_t x;
+        uint32_t y;
+        uint32_t z;
+
+        bool operator==(const Key &other) const
+        {
+            return x == other.x && y == other.y && z == other.z;
+        }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const
+        {
+            uint64_t h = key.x * 0x9E3779B97F4A7C15ull;
+            h ^= (h >> 29) + key.y * 0xBF58476D1CE4E5B9ull;
+            h ^= (h >> 31) + key.z * 0x94D049BB133111EBull;
+            return static_cast<size_t>(h ^ (h >> 32));
+        }
+    };
+
+    IndexedMesh mesh;
+    size_t count = positions.size() / 3 * 3;
+    mesh.indices.reserve(count);
+    std::unordered_map<Key, uint32_t, KeyHash> lookup;
+    lookup.reserve(count / 2);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Vec3 &p = positions[i];
+        // +0.0f folds -0.0 onto 0.0 so both weld.
+        float fx = p.x + 0.0f;
+        float fy = p.y + 0.0f;
+        float fz = p.z + 0.0f;
+        Key key;
+        std::memcpy(&key.x, &fx, 4);
+        std::memcpy(&key.y, &fy, 4);
+        std::memcpy(&key.z, &fz, 4);
+        auto [it, inserted] = lookup.try_emplace(key, static_cast<uint32_t>(mesh.vertices.size()));
+        if (inserted)
+        {
+            mesh.vertices.push_back(p);
+        }
+        mesh.indices.push_back(it->second);
+    }
+    return mesh;
+}
+
+inline std::vector<Vec3> UnweldTriangles(const IndexedMesh &mesh)
+{
+    std::vector<Vec3> positions;
+    positions.reserve(mesh.indices.size());
+    for (uint32_t index : mesh.indices)
+    {
+        positions.push_back(mesh.vertices[index]);
+    }
+    return positions;
+}
+
+namespace simplify_detail
+{
+// Symmetric 4x4 matrix, upper triangle row by row.
+struct Quadric
+{
+    double m[10] = {};
+
+    static Quadric Plane(double a, double b, double c, double d, double weight)
+    {
+        Quadric q;
+        q.m[0] = weight * a * a;
+        q.m[1] = weight * a * b;
+        q.m[2] = weight * a * c;
+        q.m[3] = weight * a * d;
+        q.m[4] = weight * b * b;
+        q.m[5] = weight * b * c;
+        q.m[6] = weight * b * d;
+        q.m[7] = weight * c * c;
+        q.m[8] = weight * c * d;
+        q.m[9] = weight * d * d;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &other)
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            m[i] += other.m[i];
+        }
+        return *this;
+    }
+
+    double Error(const Vec3 &p) const
+    {
+        double x = p.x;
+        double y = p.y;
+        double z = p.z;
+        return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x +
+               m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y +
+               m[7] * z * z + 2.0 * m[8] * z + m[9];
+    }
+
+    // Point minimizing the error, if the 3x3 system is well conditioned.
+    bool Minimizer(Vec3 &out_point) const
+    {
+        double a = m[0], b = m[1], c = m[2];
+        double d = m[4], e = m[5], f = m[7];
+        double c00 = d * f - e * e;
+        double c01 = c * e - b * f;
+        double c02 = b * e - c * d;
+        double det = a * c00 + b * c01 + c * c02;
+        double scale = std::max({std::abs(a), std::abs(d), std::abs(f)});
+        if (!(std::abs(det) > 1e-9 * scale * scale * scale))
+        {
+            return false;
+        }
+        double c11 = a * f - c * c;
+        double c12 = b * c - a * e;
+        double c22 = a * d - b * b;
+        double inv = -1.0 / det;
+        double rx = m[3], ry = m[6], rz = m[8];
+        out_point = Vec3{static_cast<float>(inv * (c00 * rx + c01 * ry + c02 * rz)),
+                         static_cast<float>(inv * (c01 * rx + c11 * ry + c12 * rz)),
+                         static_cast<float>(inv * (c02 * rx + c12 * ry + c22 * rz))};
+        return true;
+    }
+};
+
+struct Collapse
+{
+    double cost;
+    uint32_t v0;
+    uint32_t v1;
+    uint32_t version0;
+    uint32_t version1;
+    Vec3 target;
+
+    bool operator>(const Collapse &other) const
+    {
+        return cost > other.cost;
+    }
+};
+
+inline Vec3 FaceNormal(const Vec3 &a, const Vec3 &b, const Vec3 &c)
+{
+    return Cross(b - a, c - a);
+}
+
+inline float LengthSquared(const Vec3 &v)
+{
+    return Dot(v, v);
+}
+} // namespace simplify_detail
+
+// Collapses edges until at most target_triangles remain, or no collapse is
+// left that keeps the surface valid. Unreferenced vertices are dropped.
+inline IndexedMesh SimplifyMesh(const IndexedMesh &mesh, size_t target_triangles)
+{
+    using namespace simplify_detail;
+    constexpr double kBorderWeight = 100.0;
+    constexpr float kMinNormalDot = 0.2f;
+
+    size_t vertex_count = mesh.vertices.size();
+    size_t face_count = mesh.TriangleCount();
+    std::vector<Vec3> positions = mesh.vertices;
+    std::vector<uint32_t> faces(mesh.indices.begin(), mesh.indices.begin() + face_count * 3);
+    std::vector<bool> face_removed(face_count, false);
+    std::vector<bool> vertex_removed(vertex_count, false);
+    std::vector<uint32_t> version(vertex_count, 0);
+    std::vector<Quadric> quadrics(vertex_count);
+    std::vector<std::vector<uint32_t>> vertex_faces(vertex_count);
+
+    size_t live_faces = 0;
+    std::unordered_map<uint64_t, int> edge_use;
+    edge_use.reserve(face_count * 2);
+    auto edge_key = [](uint32_t a, uint32_t b)
+    {
+        return a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+    };
+
+    for (size_t f = 0; f < face_count; ++f)
+    {
+        uint32_t *v = &faces[f * 3];
+        if (v[0] == v[1] || v[1] == v[2] || v[0] == v[2])
+        {
+            face_removed[f] = true;
+            continue;
+        }
+        ++live_faces;
+        Vec3 n = FaceNormal(positions[v[0]], positions[v[1]], positions[v[2]]);
+        double area2 = std::sqrt(static_cast<double>(LengthSquared(n)));
+        if (area2 > 0.0)
+        {
+            double nx = n.x / area2, ny = n.y / area2, nz = n.z / area2;
+            double d = -(nx * positions[v[0]].x + ny * positions[v[0]].y + nz * positions[v[0]].z);
+            Quadric q = Quadric::Plane(nx, ny, nz, d, 0.5 * area2);
+            for (int k = 0; k < 3; ++k)
+            {
+                quadrics[v[k]] += q;
+            }
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            vertex_faces[v[k]].push_back(static_cast<uint32_t>(f));
+            ++edge_use[edge_key(v[k], v[(k + 1) % 3])];
+        }
+    }
+
+    // Border edges belong to one face: pin them with a plane through the
+    // edge, perpendicular to that face.
+    for (size_t f = 0; f < face_count; ++f)
+    {
+        if (face_removed[f])
+        {
+            continue;
+        }
+        const uint32_t *v = &faces[f * 3];
+        Vec3 n = FaceNormal(positions[v[0]], positions[v[1]], positions[v[2]]);
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t a = v[k];
+            uint32_t b = v[(k + 1) % 3];
+            if (edge_use[edge_key(a, b)] != 1)
+            {
+                continue;
+            }
+            Vec3 edge = positions[b] - positions[a];
+            Vec3 p = Cross(edge, n);
+            double length = std::sqrt(static_cast<double>(LengthSquared(p)));
+            if (length <= 0.0)
+            {
+                continue;
+            }
+            double px = p.x / length, py = p.y / length, pz = p.z / length;
+            double d = -(px * positions[a].x + py * positions[a].y + pz * positions[a].z);
+            Quadric q = Quadric::Plane(px, py, pz, d, kBorderWeight * LengthSquared(edge));
+            quadrics[a] += q;
+            quadrics[b] += q;
+        }
+    }
+    edge_use.clear();
+
+    auto evaluate = [&](uint32_t v0, uint32_t v1)
+    {
+        Quadric q = quadrics[v0];
+        q += quadrics[v1];
+        const Vec3 &p0 = positions[v0];
+        const Vec3 &p1 = positions[v1];
+        Vec3 mid = (p0 + p1) * 0.5f;
+        Vec3 target = mid;
+        double cost = 0.0;
+        Vec3 optimum;
+        // Distant minimizers come from nearly flat regions; the endpoints are
+        // safer there.
+        if (q.Minimizer(optimum) && LengthSquared(optimum - mid) <= 4.0f * LengthSquared(p1 - p0))
+        {
+            target = optimum;
+            cost = q.Error(optimum);
+        }
+        else
+        {
+            const Vec3 candidates[3] = {p0, p1, mid};
+            cost = q.Error(p0);
+            target = p0;
+            for (int i = 1; i < 3; ++i)
+            {
+                double e = q.Error(candidates[i]);
+                if (e < cost)
+                {
+                    cost = e;
+                    target = candidates[i];
+                }
+            }
+        }
+        return Collapse{std::max(0.0, cost), v0, v1, version[v0], version[v1], target};
+    };
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+    for (size_t f = 0; f < face_count; ++f)
+    {
+        if (face_removed[f])
+        {
+            continue;
+        }
+        const uint32_t *v = &faces[f * 3];
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t a = v[k];
+            uint32_t b = v[(k + 1) % 3];
+            // Interior edges are seen from both faces; queue them once.
+            if (edge_use.try_emplace(edge_key(a, b), 0).second)
+            {
+                heap.push(evaluate(std::min(a, b), std::max(a, b)));
+            }
+        }
+    }
+    edge_use.clear();
+
+    std::vector<uint32_t> ring0;
+    std::vector<uint32_t> ring1;
+    auto collect_ring = [&](uint32_t v, std::vector<uint32_t> &out_ring)
+    {
+        out_ring.clear();
+        for (uint32_t f : vertex_faces[v])
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t u = faces[f * 3 + k];
+                if (u != v)
+                {
+                    out_ring.push_back(u);
+                }
+            }
+        }
+        std::sort(out_ring.begin(), out_ring.end());
+        out_ring.erase(std::unique(out_ring.begin(), out_ring.end()), out_ring.end());
+    };
+
+    // Moving v to target must not flip or collapse faces that survive.
+    auto keeps_orientation = [&](uint32_t v, uint32_t other, const Vec3 &target)
+    {
+        for (uint32_t f : vertex_faces[v])
+        {
+            const uint32_t *fv = &faces[f * 3];
+            if (fv[0] == other || fv[1] == other || fv[2] == other)
+            {
+                continue;
+            }
+            Vec3 p[3] = {positions[fv[0]], positions[fv[1]], positions[fv[2]]};
+            Vec3 before = FaceNormal(p[0], p[1], p[2]);
+            for (int k = 0; k < 3; ++k)
+            {
+                if (fv[k] == v)
+                {
+                    p[k] = target;
+                }
+            }
+            Vec3 after = FaceNormal(p[0], p[1], p[2]);
+            float before_len = LengthSquared(before);
+            float after_len = LengthSquared(after);
+            if (before_len <= 0.0f)
+            {
+                continue;
+            }
+            if (after_len <= 0.0f)
+            {
+                return false;
+            }
+            float dot = Dot(before, after);
+            if (dot <= 0.0f || dot * dot < kMinNormalDot * kMinNormalDot * before_len * after_len)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Rejected edges are retried once the heap runs dry, since collapses
+    // nearby may have made them valid; stop when a pass makes no progress.
+    std::vector<Collapse> deferred;
+    size_t collapses = 0;
+    size_t collapses_at_refill = 0;
+    while (live_faces > target_triangles)
+    {
+        if (heap.empty())
+        {
+            if (deferred.empty() || collapses == collapses_at_refill)
+            {
+                break;
+            }
+            collapses_at_refill = collapses;
+            for (const Collapse &retry : deferred)
+            {
+                if (!vertex_removed[retry.v0] && !vertex_removed[retry.v1])
+                {
+                    heap.push(evaluate(retry.v0, retry.v1));
+                }
+            }
+            deferred.clear();
+            continue;
+        }
+        Collapse c = heap.top();
+        heap.pop();
+        if (vertex_removed[c.v0] || vertex_removed[c.v1] || version[c.v0] != c.version0 ||
+            version[c.v1] != c.version1)
+        {
+            continue;
+        }
+
+        // Faces removed by earlier collapses linger in the lists of their
+        // third vertex until the vertex is visited.
+        for (uint32_t v : {c.v0, c.v1})
+        {
+            std::vector<uint32_t> &list = vertex_faces[v];
+            list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t f) { return face_removed[f]; }),
+                       list.end());
+        }
+
+        // Link condition: the endpoints may only share the neighbours opposite
+        // the edge, otherwise the collapse pinches the surface.
+        collect_ring(c.v0, ring0);
+        collect_ring(c.v1, ring1);
+        size_t shared_vertices = 0;
+        for (uint32_t u : ring0)
+        {
+            shared_vertices += std::binary_search(ring1.begin(), ring1.end(), u) ? 1 : 0;
+        }
+        size_t shared_faces = 0;
+        for (uint32_t f : vertex_faces[c.v0])
+        {
+            const uint32_t *fv = &faces[f * 3];
+            shared_faces += (fv[0] == c.v1 || fv[1] == c.v1 || fv[2] == c.v1) ? 1 : 0;
+        }
+        if (shared_faces == 0 || shared_vertices != shared_faces ||
+            !keeps_orientation(c.v0, c.v1, c.target) || !keeps_orientation(c.v1, c.v0, c.target))
+        {
+            deferred.push_back(c);
+            continue;
+        }
+        ++collapses;
+
+        positions[c.v0] = c.target;
+        quadrics[c.v0] += quadrics[c.v1];
+        vertex_removed[c.v1] = true;
+        ++version[c.v0];
+        ++version[c.v1];
+
+        for (uint32_t f : vertex_faces[c.v1])
+        {
+            uint32_t *fv = &faces[f * 3];
+            if (fv[0] == c.v0 || fv[1] == c.v0 || fv[2] == c.v0)
+            {
+                face_removed[f] = true;
+                --live_faces;
+                continue;
+            }
+            for (int k = 0; k < 3; ++k)
+            {
+                if (fv[k] == c.v1)
+                {
+                    fv[k] = c.v0;
+                }
+            }
+            vertex_faces[c.v0].push_back(f);
+        }
+        vertex_faces[c.v1].clear();
+        std::vector<uint32_t> &kept = vertex_faces[c.v0];
+        kept.erase(std::remove_if(kept.begin(), kept.end(), [&](uint32_t f) { return face_removed[f]; }),
+                   kept.end());
+
+        collect_ring(c.v0, ring0);
+        for (uint32_t u : ring0)
+        {
+            heap.push(evaluate(std::min(c.v0, u), std::max(c.v0, u)));
+        }
+    }
+
+    IndexedMesh result;
+    std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+    result.indices.reserve(live_faces * 3);
+    for (size_t f = 0; f < face_count; ++f)
+    {
+        if (face_removed[f])
+        {
+            continue;
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t v = faces[f * 3 + k];
+            if (remap[v] == UINT32_MAX)
+            {
+                remap[v] = static_cast<uint32_t>(result.vertices.size());
+                result.vertices.push_back(positions[v]);
+            }
+            result.indices.push_back(remap[v]);
+        }
+    }
+    return result;
+}
+
+// One detail level of a mesh and the acceleration structure built for it.
+struct MeshLod
+{
+    std::vector<HittablePtr> objects;
+    size_t triangles = 0;
+    size_t accel_bytes = 0;
+    // accel_bytes is EstimateBVHBytes' figure rather than a measured size.
+    bool accel_bytes_estimated = false;
+    double simplify_ms = 0.0;
+    double build_ms = 0.0;
+};
+
+// Builds one level's acceleration structure. Pointer levels are lists of
+// Triangles that the scene's pointer BVH is built over; Compact and Lazy
+// levels are one CompactBVH or LazyBVH each (a LazyBVH's build_ms covers only
+// its eager top levels). Meshes too large for the compact BVH get a pointer
+// level instead (see AppendCompactMesh).
+inline MeshLod BuildMeshLod(const std::vector<Vec3> &positions, MeshAccel accel)
+{
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    MeshLod lod;
+    if (accel == MeshAccel::Compact)
+    {
+        AppendCompactMesh(positions, lod.objects);
+    }
+    else if (accel == MeshAccel::Lazy)
+    {
+        lod.objects.push_back(std::make_shared<LazyBVH>(MakeTriangles(positions)));
+    }
+    else
+    {
+        lod.objects = MakeTriangles(positions);
+    }
+
+    const Hittable *single = lod.objects.size() == 1 ? lod.objects[0].get() : nullptr;
+    if (const auto *mesh = dynamic_cast<const CompactBVH *>(single))
+    {
+        lod.triangles = mesh->triangles.size();
+        lod.accel_bytes = mesh->MemoryBytes();
+    }
+    else
+    {
+        const auto *lazy = dynamic_cast<const LazyBVH *>(single);
+        lod.triangles = lazy ? lazy->objects.size() : lod.objects.size();
+        lod.accel_bytes = EstimateBVHBytes(lod.triangles, sizeof(Triangle));
+        lod.accel_bytes_estimated = true;
+    }
+    lod.build_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return lod;
+}
+
+// The levels below a full-detail mesh of positions: each is simplified from
+// the one before to a quarter of its triangles, up to level_count - 1
+// levels. Stops early when the mesh gets too small, no longer simplifies, or
+// cancel is set. Meant to run off the render thread while the full mesh
+// (BuildMeshLod) is already in use.
+inline std::vector<MeshLod> BuildCoarseMeshLods(const std::vector<Vec3> &positions,
+                                                MeshAccel accel,
+                                                int level_count = 3,
+                                                const std::atomic<bool> *cancel = nullptr)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr size_t kMinLodTriangles = 256;
+
+    std::vector<MeshLod> lods;
+    size_t previous = positions.size() / 3;
+    IndexedMesh level;
+    for (int i = 1; i < level_count; ++i)
+    {
+        size_t target = previous / 4;
+        if (target < kMinLodTriangles || (cancel && cancel->load(std::memory_order_relaxed)))
+        {
+            break;
+        }
+
+        Clock::time_point start = Clock::now();
+        if (i == 1)
+        {
+            level = WeldTriangles(positions);
+        }
+        level = SimplifyMesh(level, target);
+        double simplify_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (level.TriangleCount() == 0 || level.TriangleCount() * 10 > previous * 9)
+        {
+            break;
+        }
+
+        lods.push_back(BuildMeshLod(UnweldTriangles(level), accel));
+        lods.back().simplify_ms = simplify_ms;
+        previous = lods.back().triangles;
+    }
+    return lods;
+}
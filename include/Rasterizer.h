@@ -0,0 +1,442 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "Camera.h"
+#include "CompactBVH.h"
+#include "CpuDispatch.h"
+#include "Hittable.h"
+#include "Simd.h"
+#include "Trace.h"
+#include "Vec3.h"
+
+// Tiled, multithreaded CPU rasterizer for primary visibility. Coverage and
+// depth come from the same ray/triangle equations the tracer uses, written
+// as functions that are linear in the pixel position (homogeneous
+// rasterization), so no near-plane clipping is needed.
+
+struct TriangleSpan
+{
+    const PackedTriangle *data = nullptr;
+    size_t count = 0;
+};
+
+// Per pixel: id of the nearest covering triangle (index over the concatenated
+// spans) and its ray parameter along the unnormalized pixel direction.
+struct VisibilityBuffer
+{
+    static constexpr uint32_t kNoPrimitive = 0xffffffffu;
+
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    std::vector<float> depth;
+    std::vector<uint32_t> primitive;
+
+    void Reset(int new_width, int new_height)
+    {
+        width = new_width;
+        height = new_height;
+        stride = (new_width + 15) & ~15;
+        size_t size = static_cast<size_t>(stride) * static_cast<size_t>(new_height);
+        depth.assign(size, std::numeric_limits<float>::infinity());
+        primitive.assign(size, kNoPrimitive);
+    }
+};
+
+// Maps an id over the concatenated spans back to its triangle.
+inline const PackedTriangle &TriangleAt(const std::vector<TriangleSpan> &spans, uint32_t id)
+{
+    size_t index = id;
+    size_t last = 0;
+    while (last + 1 < spans.size() && index >= spans[last].count)
+    {
+        index -= spans[last].count;
+        ++last;
+    }
+    return spans[last].data[index];
+}
+
+// Primary hits for the render kernel: rasterized triangles plus a traced
+// structure for everything that isn't a triangle (spheres, sphere sets).
+struct PrimaryVisibility
+{
+    VisibilityBuffer buffer;
+    std::vector<TriangleSpan> spans;
+    const Hittable *traced = nullptr;
+    // The rasterized triangles as a traceable structure, for raster misses.
+    const Hittable *triangles = nullptr;
+
+    // Reconstructs the hit exactly as root.Hit would. If the raster's
+    // conservative coverage picked a triangle the exact test rejects (pixel
+    // on an edge), the pixel falls back to a full trace; if the raster found
+    // nothing, the triangles are traced in case a sliver fell between samples.
+    bool Hit(int x, int y, const Ray3 &ray, const Hittable &root, HitRecord &out_hit) const
+    {
+        uint32_t id = buffer.primitive[static_cast<size_t>(y) * static_cast<size_t>(buffer.stride) + static_cast<size_t>(x)];
+        bool found = false;
+        if (id == VisibilityBuffer::kNoPrimitive)
+        {
+            found = triangles && triangles->Hit(ray, 0.001f, 1000.0f, out_hit);
+        }
+        else
+        {
+            found = CompactBVH::HitTriangle(TriangleAt(spans, id), ray, 0.001f, 1000.0f, out_hit);
+            if (!found)
+            {
+                return root.Hit(ray, 0.001f, 1000.0f, out_hit);
+            }
+        }
+        if (traced)
+        {
+            HitRecord other;
+            if (traced->Hit(ray, 0.001f, found ? out_hit.t : 1000.0f, other))
+            {
+                out_hit = other;
+                found = true;
+            }
+        }
+        return found;
+    }
+};
+
+struct RasterStats
+{
+    size_t triangles = 0;
+    size_t binned = 0;
+    double bin_ms = 0.0;
+    double raster_ms = 0.0;
+};
+
+namespace raster_detail
+{
+// Screen-space pixel bounds [x0, x1) x [y0, y1); false if the triangle is
+// entirely behind the camera or off screen. A triangle crossing the camera
+// plane is given the whole screen.
+inline bool ScreenBounds(const PackedTriangle &tri, const CameraBasis &basis, int width, int height,
+                         int &x0, int &y0, int &x1, int &y1)
+{
+    const Vec3 *verts[3] = {&tri.v0, &tri.v1, &tri.v2};
+    float min_x = std::numeric_limits<float>::infinity();
+    float min_y = min_x;
+    float max_x = -min_x;
+    float max_y = -min_x;
+    int behind = 0;
+    for (const Vec3 *p : verts)
+    {
+        Vec3 d = *p - basis.position;
+        float z = Dot(d, basis.forward);
+        if (z <= 1e-4f)
+        {
+            ++behind;
+            continue;
+        }
+        float sx = Dot(d, basis.right) / (z * basis.half_width);
+        float sy = Dot(d, basis.up) / (z * basis.half_height);
+        float px = (sx + 1.0f) * 0.5f * static_cast<float>(width) - 0.5f;
+        float py = (1.0f - sy) * 0.5f * static_cast<float>(height) - 0.5f;
+        min_x = std::min(min_x, px);
+        max_x = std::max(max_x, px);
+        min_y = std::min(min_y, py);
+        max_y = std::max(max_y, py);
+    }
+    if (behind == 3)
+    {
+        return false;
+    }
+    if (behind > 0)
+    {
+        x0 = 0;
+        y0 = 0;
+        x1 = width;
+        y1 = height;
+        return true;
+    }
+
+    // One pixel of slack on each side keeps the bounds conservative.
+    x0 = static_cast<int>(std::max(0.0f, std::floor(min_x) - 1.0f));
+    y0 = static_cast<int>(std::max(0.0f, std::floor(min_y) - 1.0f));
+    x1 = static_cast<int>(std::min(static_cast<float>(width), std::ceil(max_x) + 2.0f));
+    y1 = static_cast<int>(std::min(static_cast<float>(height), std::ceil(max_y) + 2.0f));
+    return x0 < x1 && y0 < y1;
+}
+
+struct PixelPlane
+{
+    float c0;
+    float cx;
+    float cy;
+};
+
+inline PixelPlane MakePlane(const Vec3 &n, const Vec3 &d0, const Vec3 &dx, const Vec3 &dy)
+{
+    return PixelPlane{Dot(d0, n), Dot(dx, n), Dot(dy, n)};
+}
+
+template <typename V>
+RT_FORCE_INLINE void RasterizeTriangle(const PackedTriangle &tri,
+                              uint32_t id,
+                              const Vec3 &origin,
+                              const Vec3 &d0,
+                              const Vec3 &dx,
+                              const Vec3 &dy,
+                              int x0,
+                              int y0,
+                              int x1,
+                              int y1,
+                              VisibilityBuffer &vis)
+{
+    // With D(x, y) = d0 + x * dx + y * dy the Moller-Trumbore terms are
+    //   det = D . (e2 x e1), u * det = D . (e2 x tvec), v * det = D . qvec,
+    // and t * det is constant, so all three are linear in x and y.
+    Vec3 e1 = tri.v1 - tri.v0;
+    Vec3 e2 = tri.v2 - tri.v0;
+    Vec3 tvec = origin - tri.v0;
+    Vec3 qvec = Cross(tvec, e1);
+    PixelPlane det_plane = MakePlane(Cross(e2, e1), d0, dx, dy);
+    PixelPlane u_plane = MakePlane(Cross(e2, tvec), d0, dx, dy);
+    PixelPlane v_plane = MakePlane(qvec, d0, dx, dy);
+    float t_num = Dot(e2, qvec);
+
+    // Widen coverage slightly; misses are resolved exactly afterwards.
+    const float kEdgeSlack = 1e-4f;
+    alignas(64) static const float kLaneOffsets[16] = {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                                                       8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f};
+    const V lanes = V::Load(kLaneOffsets);
+    const V lo = V::Set(-kEdgeSlack);
+    const V hi = V::Set(1.0f + kEdgeSlack);
+    const V zero = V::Set(0.0f);
+    const V one = V::Set(1.0f);
+    const V t_numerator = V::Set(t_num);
+
+    int x_start = x0 & ~(V::kWidth - 1);
+    for (int y = y0; y < y1; ++y)
+    {
+        float fy = static_cast<float>(y);
+        float det_row = det_plane.c0 + fy * det_plane.cy;
+        float u_row = u_plane.c0 + fy * u_plane.cy;
+        float v_row = v_plane.c0 + fy * v_plane.cy;
+        float *depth_row = vis.depth.data() + static_cast<size_t>(y) * static_cast<size_t>(vis.stride);
+        uint32_t *prim_row = vis.primitive.data() + static_cast<size_t>(y) * static_cast<size_t>(vis.stride);
+
+        for (int x = x_start; x < x1; x += V::kWidth)
+        {
+            V fx = V::Set(static_cast<float>(x)) + lanes;
+            V det = V::Set(det_row) + fx * V::Set(det_plane.cx);
+            V inv_det = one / det;
+            V u = (V::Set(u_row) + fx * V::Set(u_plane.cx)) * inv_det;
+            V v = (V::Set(v_row) + fx * V::Set(v_plane.cx)) * inv_det;
+            V t = t_numerator * inv_det;
+
+            V depth = V::Load(depth_row + x);
+            V inside = (u >= lo) & (v >= lo) & ((u + v) <= hi) & (t > zero) & (t < depth);
+            Select(inside, t, depth).Store(depth_row + x);
+
+            unsigned covered = MoveMask(inside);
+            for (int lane = 0; covered != 0; ++lane, covered >>= 1)
+            {
+                if (covered & 1u)
+                {
+                    prim_row[x + lane] = id;
+                }
+            }
+        }
+    }
+}
+
+struct TileSetup
+{
+    const std::vector<TriangleSpan> *spans;
+    CameraBasis basis;
+    Vec3 d0;
+    Vec3 dx;
+    Vec3 dy;
+    int width;
+    int height;
+};
+
+// Rasterizes one bin of triangle ids into the tile [x0, x1) x [y0, y1).
+template <typename V>
+RT_FORCE_INLINE void RasterizeBinImpl(const TileSetup &setup, const uint32_t *ids, size_t count,
+                                      int tile_x0, int tile_y0, int tile_x1, int tile_y1, VisibilityBuffer &vis)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const PackedTriangle &tri = TriangleAt(*setup.spans, ids[i]);
+        int x0, y0, x1, y1;
+        ScreenBounds(tri, setup.basis, setup.width, setup.height, x0, y0, x1, y1);
+        x0 = std::max(x0, tile_x0);
+        y0 = std::max(y0, tile_y0);
+        x1 = std::min(x1, tile_x1);
+        y1 = std::min(y1, tile_y1);
+        RasterizeTriangle<V>(tri, ids[i], setup.basis.position, setup.d0, setup.dx, setup.dy, x0, y0, x1, y1, vis);
+    }
+}
+
+using RasterBinFn = void (*)(const TileSetup &, const uint32_t *, size_t, int, int, int, int, VisibilityBuffer &);
+
+inline void RasterizeBinBaseline(const TileSetup &setup, const uint32_t *ids, size_t count,
+                                 int tile_x0, int tile_y0, int tile_x1, int tile_y1, VisibilityBuffer &vis)
+{
+    RasterizeBinImpl<SimdFloatWide>(setup, ids, count, tile_x0, tile_y0, tile_x1, tile_y1, vis);
+}
+
+#if RT_ISA_DISPATCH
+RT_TARGET_AVX2 inline void RasterizeBinAvx2(const TileSetup &setup, const uint32_t *ids, size_t count,
+                                            int tile_x0, int tile_y0, int tile_x1, int tile_y1, VisibilityBuffer &vis)
+{
+    RasterizeBinImpl<SimdFloat8>(setup, ids, count, tile_x0, tile_y0, tile_x1, tile_y1, vis);
+}
+
+RT_TARGET_AVX512 inline void RasterizeBinAvx512(const TileSetup &setup, const uint32_t *ids, size_t count,
+                                                int tile_x0, int tile_y0, int tile_x1, int tile_y1, VisibilityBuffer &vis)
+{
+    RasterizeBinImpl<SimdFloat16>(setup, ids, count, tile_x0, tile_y0, tile_x1, tile_y1, vis);
+}
+#endif
+
+inline RasterBinFn SelectRasterBinKernel(CpuIsa isa)
+{
+#if RT_ISA_DISPATCH
+    switch (isa)
+    {
+    case CpuIsa::Avx512:
+        return &RasterizeBinAvx512;
+    case CpuIsa::Avx2:
+        return &RasterizeBinAvx2;
+    default:
+        break;
+    }
+#else
+    (void)isa;
+#endif
+    return &RasterizeBinBaseline;
+}
+} // namespace raster_detail
+
+// Fills vis for a width x height frame seen through basis. Triangles are
+// binned into 64x64 tiles by thread-private bins, then tiles are rasterized
+// in parallel; each tile visits triangles in id order, so ties resolve to the
+// lowest id regardless of thread count.
+inline RasterStats RasterizeVisibility(VisibilityBuffer &vis,
+                                       int width,
+                                       int height,
+                                       const CameraBasis &basis,
+                                       const std::vector<TriangleSpan> &spans,
+                                       unsigned int thread_count)
+{
+    using namespace raster_detail;
+    using Clock = std::chrono::steady_clock;
+    constexpr int kTileSize = 64;
+
+    RasterStats stats;
+    vis.Reset(width, height);
+    if (width <= 0 || height <= 0)
+    {
+        return stats;
+    }
+
+    for (const TriangleSpan &span : spans)
+    {
+        stats.triangles += span.count;
+    }
+
+    int tiles_x = (width + kTileSize - 1) / kTileSize;
+    int tiles_y = (height + kTileSize - 1) / kTileSize;
+    size_t tile_count = static_cast<size_t>(tiles_x) * static_cast<size_t>(tiles_y);
+    thread_count = std::max(1u, thread_count);
+
+    Vec3 dx = basis.right * (basis.half_width * 2.0f / static_cast<float>(width));
+    Vec3 dy = basis.up * (-basis.half_height * 2.0f / static_cast<float>(height));
+    Vec3 d0 = basis.forward + basis.right * (basis.half_width * (1.0f / static_cast<float>(width) - 1.0f)) +
+              basis.up * (basis.half_height * (1.0f - 1.0f / static_cast<float>(height)));
+
+    auto start = Clock::now();
+    std::vector<std::vector<std::vector<uint32_t>>> bins(thread_count, std::vector<std::vector<uint32_t>>(tile_count));
+    auto bin_range = [&](unsigned int thread_index)
+    {
+        TraceThreadName("raster");
+        TraceZone zone("raster_bin");
+        size_t begin = stats.triangles * thread_index / thread_count;
+        size_t end = stats.triangles * (thread_index + 1) / thread_count;
+        size_t span_base = 0;
+        for (const TriangleSpan &span : spans)
+        {
+            size_t lo = std::max(begin, span_base);
+            size_t hi = std::min(end, span_base + span.count);
+            for (size_t id = lo; id < hi; ++id)
+            {
+                int x0, y0, x1, y1;
+                if (!ScreenBounds(span.data[id - span_base], basis, width, height, x0, y0, x1, y1))
+                {
+                    continue;
+                }
+                for (int ty = y0 / kTileSize; ty <= (y1 - 1) / kTileSize; ++ty)
+                {
+                    for (int tx = x0 / kTileSize; tx <= (x1 - 1) / kTileSize; ++tx)
+                    {
+                        bins[thread_index][static_cast<size_t>(ty * tiles_x + tx)].push_back(static_cast<uint32_t>(id));
+                    }
+                }
+            }
+            span_base += span.count;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < thread_count; ++i)
+    {
+        workers.emplace_back(bin_range, i);
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+    auto binned = Clock::now();
+
+    TileSetup setup{&spans, basis, d0, dx, dy, width, height};
+    RasterBinFn raster_bin = SelectRasterBinKernel(ActiveCpuIsa());
+    std::atomic<size_t> next_tile{0};
+    std::atomic<size_t> binned_refs{0};
+    auto raster_tiles = [&]()
+    {
+        TraceThreadName("raster");
+        TraceZone zone("raster_tiles");
+        size_t local_refs = 0;
+        for (size_t tile = next_tile++; tile < tile_count; tile = next_tile++)
+        {
+            int tile_x0 = static_cast<int>(tile % static_cast<size_t>(tiles_x)) * kTileSize;
+            int tile_y0 = static_cast<int>(tile / static_cast<size_t>(tiles_x)) * kTileSize;
+            int tile_x1 = std::min(width, tile_x0 + kTileSize);
+            int tile_y1 = std::min(height, tile_y0 + kTileSize);
+            for (unsigned int t = 0; t < thread_count; ++t)
+            {
+                const std::vector<uint32_t> &bin = bins[t][tile];
+                raster_bin(setup, bin.data(), bin.size(), tile_x0, tile_y0, tile_x1, tile_y1, vis);
+                local_refs += bin.size();
+            }
+        }
+        binned_refs += local_refs;
+    };
+    for (unsigned int i = 0; i < thread_count; ++i)
+    {
+        workers.emplace_back(raster_tiles);
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    stats.binned = binned_refs;
+    stats.bin_ms = std::chrono::duration<double, std::milli>(binned - start).count();
+    stats.raster_ms = std::chrono::duration<double, std::milli>(Clock::now() - binned).count();
+    return stats;
+}
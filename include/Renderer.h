@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <random>
 #include <thread>
@@ -10,7 +11,11 @@
 
 #include "BVH.h"
 #include "Camera.h"
+#include "CompactBVH.h"
+#include "CpuDispatch.h"
+#include "Rasterizer.h"
 #include "Sphere.h"
+#include "Trace.h"
 #include "Triangle.h"
 #include "Hittable.h"
 #include "Vec3.h"
@@ -49,61 +54,104 @@ inline Vec3 FresnelSchlick(float cos_theta, const Vec3 &f0)
     return f0 + (Vec3{1.0f, 1.0f, 1.0f} - f0) * t;
 }
 
-inline Vec3 ShadeHit(const HitRecord &hit,
-                     const Vec3 &view_dir,
-                     const RenderParams &params,
-                     const Hittable &scene,
-                     std::mt19937 &rng)
+// Per-frame shading constants derived from RenderParams.
+struct ShadingContext
 {
-    if (params.debug_normals)
+    Vec3 light_position;
+    float light_radius = 0.0f;
+    int samples = 1;
+    Vec3 albedo;
+    Vec3 ambient;
+    Vec3 diffuse;
+    Vec3 f0;
+    Vec3 light_color;
+    float spec_power = 1.0f;
+
+    explicit ShadingContext(const RenderParams &params)
+        : light_position(params.light_position),
+          light_radius(params.light_radius),
+          samples(std::max(1, params.shadow_samples)),
+          albedo(params.albedo),
+          ambient(params.albedo * 0.12f),
+          diffuse(params.albedo * (1.0f - params.metallic)),
+          f0(Vec3{0.04f, 0.04f, 0.04f} * (1.0f - params.metallic) + params.albedo * params.metallic),
+          light_color(params.light_intensity * Vec3{1.0f, 0.98f, 0.92f}),
+          spec_power(2.0f + std::pow(1.0f - params.roughness, 4.0f) * 128.0f)
+    {
+    }
+};
+
+// Shading specialized at compile time:
+//   kDebugNormals  visualize normals only
+//   kHardShadows   point light (radius 0): one unjittered shadow ray
+//   kDielectric    metallic == 0: grey F0, scalar Fresnel
+//   kSamples       fixed shadow sample count, or 0 to use ctx.samples
+template <bool kDebugNormals, bool kHardShadows, bool kDielectric, int kSamples>
+RT_FORCE_INLINE Vec3 ShadeHit(const HitRecord &hit,
+                              const Vec3 &view_dir,
+                              const ShadingContext &ctx,
+                              const Hittable &scene,
+                              std::mt19937 &rng)
+{
+    if constexpr (kDebugNormals)
     {
         return 0.5f * (hit.normal + Vec3{1.0f, 1.0f, 1.0f});
     }
+    else
+    {
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
 
-    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+        Vec3 color = ctx.ambient;
+        const int samples = kHardShadows ? 1 : (kSamples > 0 ? kSamples : ctx.samples);
+        float shadow_accum = 0.0f;
+        Vec3 light_accum{};
+        for (int i = 0; i < samples; ++i)
+        {
+            Vec3 light_pos = ctx.light_position;
+            if constexpr (!kHardShadows)
+            {
+                Vec3 rand_dir = Normalize(Vec3{dist(rng) * 2.0f - 1.0f,
+                                               dist(rng) * 2.0f - 1.0f,
+                                               dist(rng) * 2.0f - 1.0f});
+                light_pos = ctx.light_position + rand_dir * ctx.light_radius;
+            }
+            Vec3 to_light = light_pos - hit.point;
+            float light_dist = Length(to_light);
+            Vec3 light_dir = to_light / std::max(1e-4f, light_dist);
 
-    Vec3 f0 = Vec3{0.04f, 0.04f, 0.04f} * (1.0f - params.metallic) + params.albedo * params.metallic;
-    float ambient = 0.12f;
-    Vec3 color = params.albedo * ambient;
+            Ray3 shadow_ray{hit.point + hit.normal * 0.001f, light_dir};
+            HitRecord shadow_hit;
+            bool occluded = scene.Hit(shadow_ray, 0.001f, light_dist - 0.002f, shadow_hit);
+            if (!occluded)
+            {
+                float ndotl = std::max(0.0f, Dot(hit.normal, light_dir));
+                Vec3 half_vec = Normalize(light_dir + view_dir);
+                float ndoth = std::max(0.0f, Dot(hit.normal, half_vec));
+                float spec = std::pow(ndoth, ctx.spec_power);
+                float cos_theta = std::max(0.0f, Dot(view_dir, half_vec));
 
-    int samples = std::max(1, params.shadow_samples);
-    float shadow_accum = 0.0f;
-    Vec3 light_accum{};
-    for (int i = 0; i < samples; ++i)
-    {
-        Vec3 rand_dir = Normalize(Vec3{dist(rng) * 2.0f - 1.0f,
-                                       dist(rng) * 2.0f - 1.0f,
-                                       dist(rng) * 2.0f - 1.0f});
-        Vec3 light_pos = params.light_position + rand_dir * params.light_radius;
-        Vec3 to_light = light_pos - hit.point;
-        float light_dist = Length(to_light);
-        Vec3 light_dir = to_light / std::max(1e-4f, light_dist);
-
-        Ray3 shadow_ray{hit.point + hit.normal * 0.001f, light_dir};
-        HitRecord shadow_hit;
-        bool occluded = scene.Hit(shadow_ray, 0.001f, light_dist - 0.002f, shadow_hit);
-        if (!occluded)
+                if constexpr (kDielectric)
+                {
+                    float t = std::pow(1.0f - std::clamp(cos_theta, 0.0f, 1.0f), 5.0f);
+                    float fresnel = 0.04f + 0.96f * t;
+                    light_accum += (ctx.albedo * ndotl + Vec3{1.0f, 1.0f, 1.0f} * (fresnel * spec)) * ctx.light_color;
+                }
+                else
+                {
+                    Vec3 fresnel = FresnelSchlick(cos_theta, ctx.f0);
+                    light_accum += (ctx.diffuse * ndotl + fresnel * spec) * ctx.light_color;
+                }
+                shadow_accum += 1.0f;
+            }
+        }
+
+        if (shadow_accum > 0.0f)
         {
-            float ndotl = std::max(0.0f, Dot(hit.normal, light_dir));
-            Vec3 half_vec = Normalize(light_dir + view_dir);
-            float ndoth = std::max(0.0f, Dot(hit.normal, half_vec));
-            float spec_power = 2.0f + std::pow(1.0f - params.roughness, 4.0f) * 128.0f;
-            float spec = std::pow(ndoth, spec_power);
-
-            Vec3 fresnel = FresnelSchlick(std::max(0.0f, Dot(view_dir, half_vec)), f0);
-            Vec3 diffuse = params.albedo * (1.0f - params.metallic);
-            Vec3 light_color = params.light_intensity * Vec3{1.0f, 0.98f, 0.92f};
-            light_accum += (diffuse * ndotl + fresnel * spec) * light_color;
-            shadow_accum += 1.0f;
+            color += light_accum / shadow_accum;
         }
-    }
 
-    if (shadow_accum > 0.0f)
-    {
-        color += light_accum / shadow_accum;
+        return Clamp01(color);
     }
-
-    return Clamp01(color);
 }
 
 inline Vec3 BackgroundColor(float v)
@@ -113,13 +161,277 @@ inline Vec3 BackgroundColor(float v)
                    Vec3{0.02f, 0.04f, 0.08f} * t);
 }
 
-inline void RenderScene(std::vector<Color> &pixels,
+inline Triangle SceneTriangle()
+{
+    Triangle tri;
+    tri.v0 = Vec3{-2.0f, -1.0f, -2.0f};
+    tri.v1 = Vec3{2.0f, -1.0f, -2.0f};
+    tri.v2 = Vec3{0.0f, 1.5f, -3.0f};
+    return tri;
+}
+
+inline HittablePtr BuildSceneBVH(const RenderParams &params,
+                                 const std::vector<HittablePtr> &extra_objects)
+{
+    std::vector<HittablePtr> objects;
+    objects.reserve(2 + extra_objects.size());
+    objects.push_back(std::make_shared<Sphere>(params.sphere));
+    objects.push_back(std::make_shared<Triangle>(SceneTriangle()));
+    for (const auto &obj : extra_objects)
+    {
+        objects.push_back(obj);
+    }
+
+    return BuildBVH(objects, 0, objects.size());
+}
+
+// Scene split for rasterized primary visibility: triangles are rasterized
+// (compact meshes in place, loose triangles copied), everything else is traced.
+// root still holds the whole scene for shadow rays and raster fallbacks;
+// triangle_root holds just the rasterized triangles for pixels the raster missed.
+struct HybridScene
+{
+    HittablePtr root;
+    HittablePtr traced_root;
+    HittablePtr triangle_root;
+    std::vector<HittablePtr> meshes;
+    std::vector<PackedTriangle> loose_triangles;
+    PrimaryVisibility visibility;
+    RasterStats raster_stats;
+};
+
+inline void BuildHybridScene(const RenderParams &params,
+                             const std::vector<HittablePtr> &extra_objects,
+                             HybridScene &scene)
+{
+    TraceZone zone("BuildHybridScene");
+    scene.root = BuildSceneBVH(params, extra_objects);
+    scene.meshes.clear();
+    scene.loose_triangles.clear();
+
+    std::vector<HittablePtr> traced;
+    std::vector<HittablePtr> rasterized;
+    traced.push_back(std::make_shared<Sphere>(params.sphere));
+    Triangle tri = SceneTriangle();
+    scene.loose_triangles.push_back(PackedTriangle{tri.v0, tri.v1, tri.v2});
+    rasterized.push_back(std::make_shared<Triangle>(tri));
+    for (const auto &obj : extra_objects)
+    {
+        if (const auto *triangle = dynamic_cast<const Triangle *>(obj.get()))
+        {
+            scene.loose_triangles.push_back(PackedTriangle{triangle->v0, triangle->v1, triangle->v2});
+            rasterized.push_back(obj);
+        }
+        else if (dynamic_cast<const CompactBVH *>(obj.get()))
+        {
+            scene.meshes.push_back(obj);
+            rasterized.push_back(obj);
+        }
+        else
+        {
+            traced.push_back(obj);
+        }
+    }
+    scene.traced_root = BuildBVH(traced, 0, traced.size());
+    scene.triangle_root = BuildBVH(rasterized, 0, rasterized.size());
+
+    scene.visibility.traced = scene.traced_root.get();
+    scene.visibility.triangles = scene.triangle_root.get();
+    scene.visibility.spans.clear();
+    scene.visibility.spans.push_back(TriangleSpan{scene.loose_triangles.data(), scene.loose_triangles.size()});
+    for (const auto &mesh : scene.meshes)
+    {
+        const auto &triangles = static_cast<const CompactBVH &>(*mesh).triangles;
+        scene.visibility.spans.push_back(TriangleSpan{triangles.data(), triangles.size()});
+    }
+}
+
+template <bool kDebugNormals, bool kHardShadows, bool kDielectric, int kSamples, bool kRasterPrimary>
+RT_FORCE_INLINE void RenderTileKernel(Color *out,
+                                      int out_stride,
+                                      int width,
+                                      int height,
+                                      int x0,
+                                      int y0,
+                                      int x1,
+                                      int y1,
+                                      const CameraBasis &basis,
+                                      const ShadingContext &ctx,
+                                      const Hittable &root,
+                                      const PrimaryVisibility *primary)
+{
+    std::mt19937 rng(static_cast<unsigned int>(y0 * 73856093u + width * 19349663u + x0 * 83492791u));
+    for (int y = y0; y < y1; ++y)
+    {
+        for (int x = x0; x < x1; ++x)
+        {
+            float u = (2.0f * (static_cast<float>(x) + 0.5f) / static_cast<float>(width) - 1.0f);
+            float v = (1.0f - 2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(height));
+
+            Ray3 ray = basis.GetRay(u, v);
+            Vec3 color = Vec3{0.08f, 0.09f, 0.12f};
+
+            HitRecord hit;
+            bool found = false;
+            if constexpr (kRasterPrimary)
+            {
+                found = primary->Hit(x, y, ray, root, hit);
+            }
+            else
+            {
+                (void)primary;
+                found = root.Hit(ray, 0.001f, 1000.0f, hit);
+            }
+            if (found)
+            {
+                Vec3 view_dir = Normalize(-ray.direction);
+                color = ShadeHit<kDebugNormals, kHardShadows, kDielectric, kSamples>(hit, view_dir, ctx, root, rng);
+            }
+            else
+            {
+                color = BackgroundColor(v);
+            }
+
+            size_t index = static_cast<size_t>((y - y0) * out_stride + (x - x0));
+            out[index] = Color{ToByte(color.x), ToByte(color.y), ToByte(color.z), 255};
+        }
+    }
+}
+
+using TileKernel = void (*)(Color *, int, int, int, int, int, int, int,
+                            const CameraBasis &, const ShadingContext &, const Hittable &,
+                            const PrimaryVisibility *);
+
+#if RT_ISA_DISPATCH
+// The same kernels compiled for AVX2 and AVX-512; the shading body is
+// inlined into each, scene traversal dispatches on its own.
+template <bool kDebugNormals, bool kHardShadows, bool kDielectric, int kSamples, bool kRasterPrimary>
+RT_TARGET_AVX2 void RenderTileKernelAvx2(Color *out, int out_stride, int width, int height,
+                                         int x0, int y0, int x1, int y1,
+                                         const CameraBasis &basis, const ShadingContext &ctx,
+                                         const Hittable &root, const PrimaryVisibility *primary)
+{
+    RenderTileKernel<kDebugNormals, kHardShadows, kDielectric, kSamples, kRasterPrimary>(
+        out, out_stride, width, height, x0, y0, x1, y1, basis, ctx, root, primary);
+}
+
+template <bool kDebugNormals, bool kHardShadows, bool kDielectric, int kSamples, bool kRasterPrimary>
+RT_TARGET_AVX512 void RenderTileKernelAvx512(Color *out, int out_stride, int width, int height,
+                                             int x0, int y0, int x1, int y1,
+                                             const CameraBasis &basis, const ShadingContext &ctx,
+                                             const Hittable &root, const PrimaryVisibility *primary)
+{
+    RenderTileKernel<kDebugNormals, kHardShadows, kDielectric, kSamples, kRasterPrimary>(
+        out, out_stride, width, height, x0, y0, x1, y1, basis, ctx, root, primary);
+}
+#endif
+
+template <CpuIsa kIsa, bool kDebugNormals, bool kHardShadows, bool kDielectric, int kSamples, bool kRasterPrimary>
+constexpr TileKernel TileKernelFor()
+{
+#if RT_ISA_DISPATCH
+    if constexpr (kIsa == CpuIsa::Avx512)
+    {
+        return &RenderTileKernelAvx512<kDebugNormals, kHardShadows, kDielectric, kSamples, kRasterPrimary>;
+    }
+    if constexpr (kIsa == CpuIsa::Avx2)
+    {
+        return &RenderTileKernelAvx2<kDebugNormals, kHardShadows, kDielectric, kSamples, kRasterPrimary>;
+    }
+#endif
+    return &RenderTileKernel<kDebugNormals, kHardShadows, kDielectric, kSamples, kRasterPrimary>;
+}
+
+template <CpuIsa kIsa, bool kDielectric, bool kRasterPrimary>
+inline TileKernel SelectSoftShadowKernel(int samples)
+{
+    switch (samples)
+    {
+    case 1:
+        return TileKernelFor<kIsa, false, false, kDielectric, 1, kRasterPrimary>();
+    case 4:
+        return TileKernelFor<kIsa, false, false, kDielectric, 4, kRasterPrimary>();
+    case 8:
+        return TileKernelFor<kIsa, false, false, kDielectric, 8, kRasterPrimary>();
+    case 16:
+        return TileKernelFor<kIsa, false, false, kDielectric, 16, kRasterPrimary>();
+    default:
+        return TileKernelFor<kIsa, false, false, kDielectric, 0, kRasterPrimary>();
+    }
+}
+
+template <CpuIsa kIsa, bool kRasterPrimary>
+inline TileKernel SelectShadingKernel(const RenderParams &params)
+{
+    if (params.debug_normals)
+    {
+        return TileKernelFor<kIsa, true, false, false, 1, kRasterPrimary>();
+    }
+    bool dielectric = params.metallic <= 0.0f;
+    if (params.light_radius <= 0.0f)
+    {
+        return dielectric ? TileKernelFor<kIsa, false, true, true, 1, kRasterPrimary>()
+                          : TileKernelFor<kIsa, false, true, false, 1, kRasterPrimary>();
+    }
+    int samples = std::max(1, params.shadow_samples);
+    return dielectric ? SelectSoftShadowKernel<kIsa, true, kRasterPrimary>(samples)
+                      : SelectSoftShadowKernel<kIsa, false, kRasterPrimary>(samples);
+}
+
+template <CpuIsa kIsa>
+inline TileKernel SelectIsaTileKernel(const RenderParams &params, bool raster_primary)
+{
+    return raster_primary ? SelectShadingKernel<kIsa, true>(params) : SelectShadingKernel<kIsa, false>(params);
+}
+
+// Picks the specialized tile kernel for this frame's parameters and the
+// active CPU ISA.
+inline TileKernel SelectTileKernel(const RenderParams &params, bool raster_primary = false)
+{
+#if RT_ISA_DISPATCH
+    switch (ActiveCpuIsa())
+    {
+    case CpuIsa::Avx512:
+        return SelectIsaTileKernel<CpuIsa::Avx512>(params, raster_primary);
+    case CpuIsa::Avx2:
+        return SelectIsaTileKernel<CpuIsa::Avx2>(params, raster_primary);
+    default:
+        break;
+    }
+#endif
+    return SelectIsaTileKernel<CpuIsa::Baseline>(params, raster_primary);
+}
+
+// Renders the pixel rectangle [x0, x1) x [y0, y1) of a width x height frame.
+// Pixel (x, y) is written to out[(y - y0) * out_stride + (x - x0)].
+inline void RenderTile(Color *out,
+                       int out_stride,
+                       int width,
+                       int height,
+                       int x0,
+                       int y0,
+                       int x1,
+                       int y1,
+                       const OrbitCamera &camera,
+                       const RenderParams &params,
+                       const Hittable &root)
+{
+    float aspect = static_cast<float>(width) / static_cast<float>(height);
+    SelectTileKernel(params)(out, out_stride, width, height, x0, y0, x1, y1,
+                             camera.Basis(aspect), ShadingContext(params), root, nullptr);
+}
+
+// Renders a full frame against an already built scene root. With primary,
+// camera-ray hits come from its visibility buffer, which must already hold
+// this frame's rasterization.
+inline void RenderFrame(std::vector<Color> &pixels,
                         int width,
                         int height,
                         const OrbitCamera &camera,
                         const RenderParams &params,
-                        const std::vector<HittablePtr> &extra_objects,
-                        unsigned int thread_count)
+                        const Hittable &root,
+                        unsigned int thread_count,
+                        const PrimaryVisibility *primary = nullptr)
 {
     if (width <= 0 || height <= 0)
     {
@@ -132,50 +444,16 @@ inline void RenderScene(std::vector<Color> &pixels,
     thread_count = std::min(thread_count, static_cast<unsigned int>(height));
     int rows_per_thread = std::max(1, height / static_cast<int>(thread_count));
 
-    std::vector<HittablePtr> objects;
-    objects.reserve(2 + extra_objects.size());
-    objects.push_back(std::make_shared<Sphere>(params.sphere));
-    Triangle tri;
-    tri.v0 = Vec3{-2.0f, -1.0f, -2.0f};
-    tri.v1 = Vec3{2.0f, -1.0f, -2.0f};
-    tri.v2 = Vec3{0.0f, 1.5f, -3.0f};
-    objects.push_back(std::make_shared<Triangle>(tri));
-    for (const auto &obj : extra_objects)
-    {
-        objects.push_back(obj);
-    }
-
-    HittablePtr bvh_root = BuildBVH(objects, 0, objects.size());
+    TileKernel kernel = SelectTileKernel(params, primary != nullptr);
+    CameraBasis basis = camera.Basis(static_cast<float>(width) / static_cast<float>(height));
+    ShadingContext ctx(params);
 
     auto render_rows = [&](int y_start, int y_end)
     {
-        float aspect = static_cast<float>(width) / static_cast<float>(height);
-        std::mt19937 rng(static_cast<unsigned int>(y_start * 73856093u + width * 19349663u));
-        for (int y = y_start; y < y_end; ++y)
-        {
-            for (int x = 0; x < width; ++x)
-            {
-                float u = (2.0f * (static_cast<float>(x) + 0.5f) / static_cast<float>(width) - 1.0f);
-                float v = (1.0f - 2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(height));
-
-                Ray3 ray = camera.GetRay(u, v, aspect);
-                Vec3 color = Vec3{0.08f, 0.09f, 0.12f};
-
-                HitRecord hit;
-                if (bvh_root->Hit(ray, 0.001f, 1000.0f, hit))
-                {
-                    Vec3 view_dir = Normalize(-ray.direction);
-                    color = ShadeHit(hit, view_dir, params, *bvh_root, rng);
-                }
-                else
-                {
-                    color = BackgroundColor(v);
-                }
-
-                size_t index = static_cast<size_t>(y * width + x);
-                pixels[index] = Color{ToByte(color.x), ToByte(color.y), ToByte(color.z), 255};
-            }
-        }
+        TraceThreadName("render");
+        TraceZone zone("render_rows");
+        kernel(pixels.data() + static_cast<size_t>(y_start * width), width,
+               width, height, 0, y_start, width, y_end, basis, ctx, root, primary);
     };
 
     std::vector<std::thread> workers;
@@ -195,3 +473,63 @@ inline void RenderScene(std::vector<Color> &pixels,
         }
     }
 }
+
+inline void RenderScene(std::vector<Color> &pixels,
+                        int width,
+                        int height,
+                        const OrbitCamera &camera,
+                        const RenderParams &params,
+                        const std::vector<HittablePtr> &extra_objects,
+                        unsigned int thread_count)
+{
+    if (width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    HittablePtr bvh_root;
+    {
+        TraceZone zone("BuildSceneBVH");
+        bvh_root = BuildSceneBVH(params, extra_objects);
+    }
+    RenderFrame(pixels, width, height, camera, params, *bvh_root, thread_count);
+}
+
+// Rasterizes triangle visibility for this camera, then shades from it.
+inline void RenderHybridFrame(std::vector<Color> &pixels,
+                              int width,
+                              int height,
+                              const OrbitCamera &camera,
+                              const RenderParams &params,
+                              HybridScene &scene,
+                              unsigned int thread_count)
+{
+    if (width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    CameraBasis basis = camera.Basis(static_cast<float>(width) / static_cast<float>(height));
+    scene.raster_stats = RasterizeVisibility(scene.visibility.buffer, width, height, basis,
+                                             scene.visibility.spans, thread_count);
+    RenderFrame(pixels, width, height, camera, params, *scene.root, thread_count, &scene.visibility);
+}
+
+// Traces width x height primary rays on the calling thread and returns rays per second.
+inline double MeasureRaysPerSecond(const Hittable &accel, const OrbitCamera &camera, int width, int height)
+{
+    float aspect = static_cast<float>(width) / static_cast<float>(height);
+    auto start = std::chrono::steady_clock::now();
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float u = (2.0f * (static_cast<float>(x) + 0.5f) / static_cast<float>(width) - 1.0f);
+            float v = (1.0f - 2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(height));
+            HitRecord hit;
+            accel.Hit(camera.GetRay(u, v, aspect), 0.001f, 1000.0f, hit);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds > 0.0 ? static_cast<double>(width) * height / seconds : 0.0;
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "raylib.h"
+
+#include "CameraPath.h"
+#include "Renderer.h"
+#include "Trace.h"
+
+// Writes finished frames to disk on its own thread. Frame buffers come from
+// a small pool, so the renderer can run at most pool_size frames ahead of
+// the disk before AcquireBuffer blocks.
+struct FrameWriter
+{
+    struct Job
+    {
+        std::string path;
+        std::vector<Color> pixels;
+        int width = 0;
+        int height = 0;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Job> queue;
+    std::vector<std::vector<Color>> free_buffers;
+    bool finishing = false;
+    int failed_writes = 0;
+    double write_seconds = 0.0;
+    std::thread thread;
+
+    explicit FrameWriter(size_t pool_size = 3)
+    {
+        free_buffers.resize(std::max<size_t>(2, pool_size));
+        thread = std::thread([this]() { Run(); });
+    }
+
+    FrameWriter(const FrameWriter &) = delete;
+    FrameWriter &operator=(const FrameWriter &) = delete;
+
+    ~FrameWriter()
+    {
+        Finish();
+    }
+
+    std::vector<Color> AcquireBuffer()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return !free_buffers.empty(); });
+        std::vector<Color> buffer = std::move(free_buffers.back());
+        free_buffers.pop_back();
+        return buffer;
+    }
+
+    void Submit(std::string path, std::vector<Color> pixels, int width, int height)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(Job{std::move(path), std::move(pixels), width, height});
+        }
+        cv.notify_all();
+    }
+
+    void Finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finishing = true;
+        }
+        cv.notify_all();
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+
+private:
+    void Run()
+    {
+        TraceThreadName("frame writer");
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return finishing || !queue.empty(); });
+                if (queue.empty())
+                {
+                    return;
+                }
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+
+            TraceZone zone("ExportImage");
+            auto start = std::chrono::steady_clock::now();
+            Image image{job.pixels.data(), job.width, job.height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+            bool ok = ExportImage(image, job.path.c_str());
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                write_seconds += seconds;
+                failed_writes += ok ? 0 : 1;
+                free_buffers.push_back(std::move(job.pixels));
+            }
+            cv.notify_all();
+        }
+    }
+};
+
+// Shared with a sequence running on another thread: it publishes progress,
+// and setting cancel stops it after the frame in progress.
+struct SequenceProgress
+{
+    std::atomic<int> frames_done{0};
+    std::atomic<int> frame_count{0};
+    std::atomic<bool> cancel{false};
+};
+
+struct SequenceStats
+{
+    bool cancelled = false;
+    int frames = 0;
+    int failed_writes = 0;
+    double build_seconds = 0.0;
+    double total_seconds = 0.0;
+    double render_seconds = 0.0;
+    double write_seconds = 0.0;
+    double min_frame_seconds = 0.0;
+    double max_frame_seconds = 0.0;
+
+    double FramesPerSecond() const
+    {
+        return total_seconds > 0.0 ? frames / total_seconds : 0.0;
+    }
+
+    void Print() const
+    {
+        std::printf("sequence: %d frames in %.2f s (%.2f fps), BVH build %.1f ms\n",
+                    frames, total_seconds, FramesPerSecond(), build_seconds * 1000.0);
+        std::printf("sequence: render avg %.1f ms (min %.1f, max %.1f), write avg %.1f ms on I/O thread\n",
+                    frames > 0 ? render_seconds * 1000.0 / frames : 0.0,
+                    min_frame_seconds * 1000.0, max_frame_seconds * 1000.0,
+                    frames > 0 ? write_seconds * 1000.0 / frames : 0.0);
+        if (failed_writes > 0)
+        {
+            std::printf("sequence: %d frame writes failed\n", failed_writes);
+        }
+        if (cancelled)
+        {
+            std::printf("sequence: cancelled\n");
+        }
+    }
+};
+
+// Renders every frame of path into output_dir/frame_NNNN.png. The scene BVH
+// is built once; PNG encoding overlaps tracing of the next frame.
+inline SequenceStats RenderSequence(const CameraPath &path,
+                                    const OrbitCamera &base_camera,
+                                    const RenderParams &params,
+                                    const std::vector<HittablePtr> &extra_objects,
+                                    int width,
+                                    int height,
+                                    const std::string &output_dir,
+                                    unsigned int thread_count,
+                                    SequenceProgress *progress = nullptr)
+{
+    using Clock = std::chrono::steady_clock;
+    SequenceStats stats;
+    if (width <= 0 || height <= 0 || path.frame_count <= 0)
+    {
+        return stats;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(output_dir, error);
+
+    auto sequence_start = Clock::now();
+    HittablePtr bvh_root;
+    {
+        TraceZone zone("BuildSceneBVH");
+        bvh_root = BuildSceneBVH(params, extra_objects);
+    }
+    stats.build_seconds = std::chrono::duration<double>(Clock::now() - sequence_start).count();
+
+    if (progress)
+    {
+        progress->frame_count.store(path.frame_count, std::memory_order_relaxed);
+    }
+
+    FrameWriter writer;
+    for (int frame = 0; frame < path.frame_count; ++frame)
+    {
+        if (progress && progress->cancel.load(std::memory_order_relaxed))
+        {
+            stats.cancelled = true;
+            break;
+        }
+        std::vector<Color> pixels;
+        {
+            TraceZone zone("AcquireBuffer");
+            pixels = writer.AcquireBuffer();
+        }
+
+        TraceZone zone("sequence_frame");
+        auto frame_start = Clock::now();
+        OrbitCamera camera = path.Evaluate(frame, base_camera);
+        RenderFrame(pixels, width, height, camera, params, *bvh_root, thread_count);
+        double seconds = std::chrono::duration<double>(Clock::now() - frame_start).count();
+
+        stats.render_seconds += seconds;
+        stats.min_frame_seconds = frame == 0 ? seconds : std::min(stats.min_frame_seconds, seconds);
+        stats.max_frame_seconds = std::max(stats.max_frame_seconds, seconds);
+        ++stats.frames;
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%04d.png", frame);
+        writer.Submit((std::filesystem::path(output_dir) / name).string(), std::move(pixels), width, height);
+        if (progress)
+        {
+            progress->frames_done.store(frame + 1, std::memory_order_relaxed);
+        }
+    }
+    writer.Finish();
+
+    stats.total_seconds = std::chrono::duration<double>(Clock::now() - sequence_start).count();
+    stats.write_seconds = writer.write_seconds;
+    stats.failed_writes = writer.failed_writes;
+    return stats;
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cmath>
+
+#include "CpuDispatch.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Minimal packed-float wrappers for the SoA kernels. SimdFloat4 maps to SSE
+// or NEON (scalar fallback elsewhere). SimdFloat8 (AVX) and SimdFloat16
+// (AVX-512) exist when the build enables them or when ISA dispatch is
+// available; in the latter case their members carry target attributes and
+// may only be used from kernels dispatched to a matching ISA.
+// Comparisons return all-ones/all-zeros lane masks in the same type;
+// MoveMask packs a mask's lanes into the low bits of an integer.
+
+struct SimdFloat4
+{
+    static constexpr int kWidth = 4;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    __m128 v;
+
+    static SimdFloat4 Load(const float *p) { return {_mm_loadu_ps(p)}; }
+    static SimdFloat4 Set(float x) { return {_mm_set1_ps(x)}; }
+    void Store(float *p) const { _mm_storeu_ps(p, v); }
+
+    friend SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { return {_mm_add_ps(a.v, b.v)}; }
+    friend SimdFloat4 operator-(SimdFloat4 a, SimdFloat4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+    friend SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+    friend SimdFloat4 operator/(SimdFloat4 a, SimdFloat4 b) { return {_mm_div_ps(a.v, b.v)}; }
+    friend SimdFloat4 operator&(SimdFloat4 a, SimdFloat4 b) { return {_mm_and_ps(a.v, b.v)}; }
+    friend SimdFloat4 operator<(SimdFloat4 a, SimdFloat4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+    friend SimdFloat4 operator<=(SimdFloat4 a, SimdFloat4 b) { return {_mm_cmple_ps(a.v, b.v)}; }
+    friend SimdFloat4 operator>=(SimdFloat4 a, SimdFloat4 b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+    friend SimdFloat4 operator>(SimdFloat4 a, SimdFloat4 b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+    friend SimdFloat4 Sqrt(SimdFloat4 a) { return {_mm_sqrt_ps(a.v)}; }
+    friend SimdFloat4 Max(SimdFloat4 a, SimdFloat4 b) { return {_mm_max_ps(a.v, b.v)}; }
+    friend SimdFloat4 Select(SimdFloat4 mask, SimdFloat4 a, SimdFloat4 b)
+    {
+        return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+    }
+    friend unsigned MoveMask(SimdFloat4 mask) { return static_cast<unsigned>(_mm_movemask_ps(mask.v)); }
+#elif defined(__ARM_NEON)
+    float32x4_t v;
+
+    static SimdFloat4 Load(const float *p) { return {vld1q_f32(p)}; }
+    static SimdFloat4 Set(float x) { return {vdupq_n_f32(x)}; }
+    void Store(float *p) const { vst1q_f32(p, v); }
+
+    static SimdFloat4 FromMask(uint32x4_t m) { return {vreinterpretq_f32_u32(m)}; }
+    uint32x4_t Bits() const { return vreinterpretq_u32_f32(v); }
+
+    friend SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { return {vaddq_f32(a.v, b.v)}; }
+    friend SimdFloat4 operator-(SimdFloat4 a, SimdFloat4 b) { return {vsubq_f32(a.v, b.v)}; }
+    friend SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { return {vmulq_f32(a.v, b.v)}; }
+    friend SimdFloat4 operator/(SimdFloat4 a, SimdFloat4 b) { return {vdivq_f32(a.v, b.v)}; }
+    friend SimdFloat4 operator&(SimdFloat4 a, SimdFloat4 b) { return FromMask(vandq_u32(a.Bits(), b.Bits())); }
+    friend SimdFloat4 operator<(SimdFloat4 a, SimdFloat4 b) { return FromMask(vcltq_f32(a.v, b.v)); }
+    friend SimdFloat4 operator<=(SimdFloat4 a, SimdFloat4 b) { return FromMask(vcleq_f32(a.v, b.v)); }
+    friend SimdFloat4 operator>=(SimdFloat4 a, SimdFloat4 b) { return FromMask(vcgeq_f32(a.v, b.v)); }
+    friend SimdFloat4 operator>(SimdFloat4 a, SimdFloat4 b) { return FromMask(vcgtq_f32(a.v, b.v)); }
+    friend SimdFloat4 Sqrt(SimdFloat4 a) { return {vsqrtq_f32(a.v)}; }
+    friend SimdFloat4 Max(SimdFloat4 a, SimdFloat4 b) { return {vmaxq_f32(a.v, b.v)}; }
+    friend SimdFloat4 Select(SimdFloat4 mask, SimdFloat4 a, SimdFloat4 b) { return {vbslq_f32(mask.Bits(), a.v, b.v)}; }
+    friend unsigned MoveMask(SimdFloat4 mask)
+    {
+        uint32x4_t sign = vshrq_n_u32(mask.Bits(), 31);
+        return vgetq_lane_u32(sign, 0) | (vgetq_lane_u32(sign, 1) << 1) | (vgetq_lane_u32(sign, 2) << 2) |
+               (vgetq_lane_u32(sign, 3) << 3);
+    }
+#else
+    float v[4];
+
+    static SimdFloat4 Load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+    static SimdFloat4 Set(float x) { return {{x, x, x, x}}; }
+    void Store(float *p) const
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            p[i] = v[i];
+        }
+    }
+
+    template <typename Fn>
+    static SimdFloat4 Map(SimdFloat4 a, SimdFloat4 b, Fn fn)
+    {
+        return {{fn(a.v[0], b.v[0]), fn(a.v[1], b.v[1]), fn(a.v[2], b.v[2]), fn(a.v[3], b.v[3])}};
+    }
+    static float Mask(bool on)
+    {
+        return on ? -NAN : 0.0f;
+    }
+    static bool On(float m)
+    {
+        return std::signbit(m);
+    }
+
+    friend SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { return Map(a, b, [](float x, float y) { return x + y; }); }
+    friend SimdFloat4 operator-(SimdFloat4 a, SimdFloat4 b) { return Map(a, b, [](float x, float y) { return x - y; }); }
+    friend SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { return Map(a, b, [](float x, float y) { return x * y; }); }
+    friend SimdFloat4 operator/(SimdFloat4 a, SimdFloat4 b) { return Map(a, b, [](float x, float y) { return x / y; }); }
+    friend SimdFloat4 operator&(SimdFloat4 a, SimdFloat4 b) { return Map(a, b, [](float x, float y) { return Mask(On(x) && On(y)); }); }
+    friend SimdFloat4 operator<(SimdFloat4 a, SimdFloat4 b) { return Map(a, b, [](float x, float y) { return Mask(x < y); }); }
+    friend SimdFloat4 operator<=(SimdFloat4 a, SimdFloat4 b) { return Map(a, b, [](float x, float y) { return Mask(x <= y); }); }
+    friend SimdFloat4 operator>=(SimdFloat4 a, SimdFloat4 b) { return Map(a, b, [](float x, float y) { return Mask(x >= y); }); }
+    friend SimdFloat4 operator>(SimdFloat4 a, SimdFloat4 b) { return Map(a, b, [](float x, float y) { return Mask(x > y); }); }
+    friend SimdFloat4 Sqrt(SimdFloat4 a) { return Map(a, a, [](float x, float) { return std::sqrt(x); }); }
+    friend SimdFloat4 Max(SimdFloat4 a, SimdFloat4 b) { return Map(a, b, [](float x, float y) { return x > y ? x : y; }); }
+    friend SimdFloat4 Select(SimdFloat4 mask, SimdFloat4 a, SimdFloat4 b)
+    {
+        SimdFloat4 out;
+        for (int i = 0; i < 4; ++i)
+        {
+            out.v[i] = On(mask.v[i]) ? a.v[i] : b.v[i];
+        }
+        return out;
+    }
+    friend unsigned MoveMask(SimdFloat4 mask)
+    {
+        unsigned bits = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            bits |= On(mask.v[i]) ? (1u << i) : 0u;
+        }
+        return bits;
+    }
+#endif
+};
+
+#if defined(__AVX__)
+#define RT_SIMD_AVX
+#elif RT_ISA_DISPATCH
+#define RT_SIMD_AVX __attribute__((target("avx")))
+#endif
+
+#if defined(__AVX512F__)
+#define RT_SIMD_AVX512
+#elif RT_ISA_DISPATCH
+#define RT_SIMD_AVX512 __attribute__((target("avx2,avx512f")))
+#endif
+
+#if defined(RT_SIMD_AVX)
+struct SimdFloat8
+{
+    static constexpr int kWidth = 8;
+
+    __m256 v;
+
+    RT_SIMD_AVX static SimdFloat8 Load(const float *p) { return {_mm256_loadu_ps(p)}; }
+    RT_SIMD_AVX static SimdFloat8 Set(float x) { return {_mm256_set1_ps(x)}; }
+    RT_SIMD_AVX void Store(float *p) const { _mm256_storeu_ps(p, v); }
+
+    RT_SIMD_AVX friend SimdFloat8 operator+(SimdFloat8 a, SimdFloat8 b) { return {_mm256_add_ps(a.v, b.v)}; }
+    RT_SIMD_AVX friend SimdFloat8 operator-(SimdFloat8 a, SimdFloat8 b) { return {_mm256_sub_ps(a.v, b.v)}; }
+    RT_SIMD_AVX friend SimdFloat8 operator*(SimdFloat8 a, SimdFloat8 b) { return {_mm256_mul_ps(a.v, b.v)}; }
+    RT_SIMD_AVX friend SimdFloat8 operator/(SimdFloat8 a, SimdFloat8 b) { return {_mm256_div_ps(a.v, b.v)}; }
+    RT_SIMD_AVX friend SimdFloat8 operator&(SimdFloat8 a, SimdFloat8 b) { return {_mm256_and_ps(a.v, b.v)}; }
+    RT_SIMD_AVX friend SimdFloat8 operator<(SimdFloat8 a, SimdFloat8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+    RT_SIMD_AVX friend SimdFloat8 operator<=(SimdFloat8 a, SimdFloat8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+    RT_SIMD_AVX friend SimdFloat8 operator>=(SimdFloat8 a, SimdFloat8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+    RT_SIMD_AVX friend SimdFloat8 operator>(SimdFloat8 a, SimdFloat8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+    RT_SIMD_AVX friend SimdFloat8 Sqrt(SimdFloat8 a) { return {_mm256_sqrt_ps(a.v)}; }
+    RT_SIMD_AVX friend SimdFloat8 Max(SimdFloat8 a, SimdFloat8 b) { return {_mm256_max_ps(a.v, b.v)}; }
+    RT_SIMD_AVX friend SimdFloat8 Select(SimdFloat8 mask, SimdFloat8 a, SimdFloat8 b) { return {_mm256_blendv_ps(b.v, a.v, mask.v)}; }
+    RT_SIMD_AVX friend unsigned MoveMask(SimdFloat8 mask) { return static_cast<unsigned>(_mm256_movemask_ps(mask.v)); }
+};
+#endif
+
+#if defined(RT_SIMD_AVX512)
+// Masks are kept as float vectors like the narrower types; compares go
+// through k-registers and are expanded with a zero-masked move.
+struct SimdFloat16
+{
+    static constexpr int kWidth = 16;
+
+    __m512 v;
+
+    RT_SIMD_AVX512 static SimdFloat16 Load(const float *p) { return {_mm512_loadu_ps(p)}; }
+    RT_SIMD_AVX512 static SimdFloat16 Set(float x) { return {_mm512_set1_ps(x)}; }
+    RT_SIMD_AVX512 void Store(float *p) const { _mm512_storeu_ps(p, v); }
+
+    RT_SIMD_AVX512 static SimdFloat16 FromMask(__mmask16 m)
+    {
+        return {_mm512_castsi512_ps(_mm512_maskz_set1_epi32(m, -1))};
+    }
+    RT_SIMD_AVX512 __mmask16 Bits() const
+    {
+        return _mm512_cmplt_epi32_mask(_mm512_castps_si512(v), _mm512_setzero_si512());
+    }
+
+    RT_SIMD_AVX512 friend SimdFloat16 operator+(SimdFloat16 a, SimdFloat16 b) { return {_mm512_add_ps(a.v, b.v)}; }
+    RT_SIMD_AVX512 friend SimdFloat16 operator-(SimdFloat16 a, SimdFloat16 b) { return {_mm512_sub_ps(a.v, b.v)}; }
+    RT_SIMD_AVX512 friend SimdFloat16 operator*(SimdFloat16 a, SimdFloat16 b) { return {_mm512_mul_ps(a.v, b.v)}; }
+    RT_SIMD_AVX512 friend SimdFloat16 operator/(SimdFloat16 a, SimdFloat16 b) { return {_mm512_div_ps(a.v, b.v)}; }
+    RT_SIMD_AVX512 friend SimdFloat16 operator&(SimdFloat16 a, SimdFloat16 b)
+    {
+        return {_mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a.v), _mm512_castps_si512(b.v)))};
+    }
+    RT_SIMD_AVX512 friend SimdFloat16 operator<(SimdFloat16 a, SimdFloat16 b) { return FromMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)); }
+    RT_SIMD_AVX512 friend SimdFloat16 operator<=(SimdFloat16 a, SimdFloat16 b) { return FromMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ)); }
+    RT_SIMD_AVX512 friend SimdFloat16 operator>=(SimdFloat16 a, SimdFloat16 b) { return FromMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ)); }
+    RT_SIMD_AVX512 friend SimdFloat16 operator>(SimdFloat16 a, SimdFloat16 b) { return FromMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ)); }
+    RT_SIMD_AVX512 friend SimdFloat16 Sqrt(SimdFloat16 a) { return {_mm512_sqrt_ps(a.v)}; }
+    RT_SIMD_AVX512 friend SimdFloat16 Max(SimdFloat16 a, SimdFloat16 b) { return {_mm512_max_ps(a.v, b.v)}; }
+    RT_SIMD_AVX512 friend SimdFloat16 Select(SimdFloat16 mask, SimdFloat16 a, SimdFloat16 b)
+    {
+        return {_mm512_mask_blend_ps(mask.Bits(), b.v, a.v)};
+    }
+    RT_SIMD_AVX512 friend unsigned MoveMask(SimdFloat16 mask) { return mask.Bits(); }
+};
+#endif
+
+#if defined(__AVX__)
+using SimdFloatWide = SimdFloat8;
+#else
+using SimdFloatWide = SimdFloat4;
+#endif
@@ -0,0 +1,376 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "AABB.h"
+#include "CpuDispatch.h"
+#include "Hittable.h"
+#include "Simd.h"
+#include "Vec3.h"
+
+struct SphereInstance
+{
+    Vec3 center;
+    float radius = 1.0f;
+};
+
+// Many spheres as one Hittable. Spheres are grouped into blocks of
+// kBlockWidth stored as SoA lanes; an internal flat BVH over the blocks is
+// traversed with one SIMD intersection per block. Unused lanes have radius 0.
+struct SphereSet : public Hittable
+{
+    static constexpr int kBlockWidth = 8;
+
+    struct Block
+    {
+        float cx[kBlockWidth];
+        float cy[kBlockWidth];
+        float cz[kBlockWidth];
+        float radius[kBlockWidth];
+    };
+
+    // Interior: children are this index + 1 and offset. Leaf: block index offset.
+    struct Node
+    {
+        AABB bounds;
+        uint32_t offset = 0;
+        uint32_t is_leaf = 0;
+    };
+
+    std::vector<Block> blocks;
+    std::vector<Node> nodes;
+    size_t sphere_count = 0;
+
+    SphereSet() = default;
+
+    explicit SphereSet(std::vector<SphereInstance> spheres)
+    {
+        Build(std::move(spheres));
+    }
+
+    void Build(std::vector<SphereInstance> spheres)
+    {
+        blocks.clear();
+        nodes.clear();
+        spheres.erase(std::remove_if(spheres.begin(), spheres.end(),
+                                     [](const SphereInstance &s) { return !(s.radius > 0.0f); }),
+                      spheres.end());
+        sphere_count = spheres.size();
+        if (spheres.empty())
+        {
+            return;
+        }
+        blocks.reserve(spheres.size() / (kBlockWidth / 2) + 1);
+        nodes.reserve(spheres.size() / (kBlockWidth / 2) * 2 + 1);
+        BuildNode(spheres, 0, spheres.size());
+    }
+
+    size_t MemoryBytes() const
+    {
+        return blocks.capacity() * sizeof(Block) + nodes.capacity() * sizeof(Node);
+    }
+
+    template <typename Fn>
+    void ForEachSphere(Fn fn) const
+    {
+        for (const Block &block : blocks)
+        {
+            for (int lane = 0; lane < kBlockWidth; ++lane)
+            {
+                if (block.radius[lane] > 0.0f)
+                {
+                    fn(SphereInstance{Vec3{block.cx[lane], block.cy[lane], block.cz[lane]}, block.radius[lane]});
+                }
+            }
+        }
+    }
+
+    bool Hit(const Ray3 &ray, float t_min, float t_max, HitRecord &out_hit) const override
+    {
+#if RT_ISA_DISPATCH
+        if (ActiveCpuIsa() != CpuIsa::Baseline)
+        {
+            return HitAvx2(ray, t_min, t_max, out_hit);
+        }
+#endif
+        return HitImpl<SimdFloatWide>(ray, t_min, t_max, out_hit);
+    }
+
+#if RT_ISA_DISPATCH
+    // Blocks are 8 wide, so AVX-512 machines use this entry point as well.
+    RT_TARGET_AVX2 bool HitAvx2(const Ray3 &ray, float t_min, float t_max, HitRecord &out_hit) const
+    {
+        return HitImpl<SimdFloat8>(ray, t_min, t_max, out_hit);
+    }
+#endif
+
+    template <typename V>
+    RT_FORCE_INLINE bool HitImpl(const Ray3 &ray, float t_min, float t_max, HitRecord &out_hit) const
+    {
+        if (nodes.empty())
+        {
+            return false;
+        }
+
+        Vec3 inv_dir{1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+        uint32_t stack[64];
+        int stack_size = 0;
+        if (nodes[0].bounds.Hit(ray, inv_dir, t_min, t_max))
+        {
+            stack[stack_size++] = 0;
+        }
+
+        float closest = t_max;
+        const Block *best_block = nullptr;
+        int best_lane = -1;
+        while (stack_size > 0)
+        {
+            uint32_t index = stack[--stack_size];
+            const Node &node = nodes[index];
+            if (node.is_leaf)
+            {
+                const Block &block = blocks[node.offset];
+                int lane = IntersectBlock<V>(block, ray, t_min, closest);
+                if (lane >= 0)
+                {
+                    best_block = &block;
+                    best_lane = lane;
+                }
+                continue;
+            }
+
+            // Push the farther child first so the nearer one is visited next.
+            uint32_t child[2] = {index + 1, node.offset};
+            float t_enter[2];
+            bool hit[2];
+            for (int c = 0; c < 2; ++c)
+            {
+                hit[c] = nodes[child[c]].bounds.Hit(ray, inv_dir, t_min, closest, &t_enter[c]);
+            }
+            int near = (hit[0] && hit[1] && t_enter[1] < t_enter[0]) ? 1 : 0;
+            for (int c : {1 - near, near})
+            {
+                if (hit[c] && stack_size < 64)
+                {
+                    stack[stack_size++] = child[c];
+                }
+            }
+        }
+
+        if (!best_block)
+        {
+            return false;
+        }
+        Vec3 center{best_block->cx[best_lane], best_block->cy[best_lane], best_block->cz[best_lane]};
+        out_hit.t = closest;
+        out_hit.point = ray.At(closest);
+        out_hit.normal = Normalize(out_hit.point - center);
+        return true;
+    }
+
+    AABB Bounds() const override
+    {
+        return nodes.empty() ? AABB{} : nodes[0].bounds;
+    }
+
+    Vec3 Centroid() const override
+    {
+        AABB box = Bounds();
+        return (box.min + box.max) * 0.5f;
+    }
+
+    // Intersects all lanes of a block, V::kWidth spheres per SIMD step, with
+    // the same arithmetic as Sphere::Hit. Returns the nearest lane within
+    // [t_min, closest] and updates closest, or -1.
+    template <typename V>
+    RT_FORCE_INLINE static int IntersectBlock(const Block &block, const Ray3 &ray, float t_min, float &closest)
+    {
+        const V ox = V::Set(ray.origin.x);
+        const V oy = V::Set(ray.origin.y);
+        const V oz = V::Set(ray.origin.z);
+        const V dx = V::Set(ray.direction.x);
+        const V dy = V::Set(ray.direction.y);
+        const V dz = V::Set(ray.direction.z);
+        const V a = V::Set(Dot(ray.direction, ray.direction));
+        const V lo = V::Set(t_min);
+        const V hi = V::Set(closest);
+        const V zero = V::Set(0.0f);
+        const V miss = V::Set(std::numeric_limits<float>::quiet_NaN());
+
+        float t_lanes[kBlockWidth];
+        for (int base = 0; base < kBlockWidth; base += V::kWidth)
+        {
+            V r = V::Load(block.radius + base);
+            V ocx = ox - V::Load(block.cx + base);
+            V ocy = oy - V::Load(block.cy + base);
+            V ocz = oz - V::Load(block.cz + base);
+            V half_b = ocx * dx + ocy * dy + ocz * dz;
+            V c = ocx * ocx + ocy * ocy + ocz * ocz - r * r;
+            V disc = half_b * half_b - a * c;
+            V sqrt_disc = Sqrt(Max(disc, zero));
+
+            V near_root = (zero - half_b - sqrt_disc) / a;
+            V far_root = (zero - half_b + sqrt_disc) / a;
+            V near_ok = (near_root >= lo) & (near_root <= hi);
+            V root = Select(near_ok, near_root, far_root);
+            V valid = (disc >= zero) & (r > zero) & (root >= lo) & (root <= hi);
+            Select(valid, root, miss).Store(t_lanes + base);
+        }
+
+        int best = -1;
+        for (int lane = 0; lane < kBlockWidth; ++lane)
+        {
+            if (t_lanes[lane] <= closest)
+            {
+                closest = t_lanes[lane];
+                best = lane;
+            }
+        }
+        return best;
+    }
+
+private:
+    static AABB SphereBounds(const SphereInstance &s)
+    {
+        Vec3 r{s.radius, s.radius, s.radius};
+        return AABB{s.center - r, s.center + r};
+    }
+
+    uint32_t BuildNode(std::vector<SphereInstance> &spheres, size_t start, size_t end)
+    {
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+
+        AABB bounds = SphereBounds(spheres[start]);
+        AABB centroid_bounds{spheres[start].center, spheres[start].center};
+        for (size_t i = start + 1; i < end; ++i)
+        {
+            bounds = SurroundingBox(bounds, SphereBounds(spheres[i]));
+            centroid_bounds = SurroundingBox(centroid_bounds, AABB{spheres[i].center, spheres[i].center});
+        }
+        nodes[index].bounds = bounds;
+
+        size_t count = end - start;
+        if (count <= static_cast<size_t>(kBlockWidth))
+        {
+            Block block{};
+            for (size_t i = 0; i < count; ++i)
+            {
+                block.cx[i] = spheres[start + i].center.x;
+                block.cy[i] = spheres[start + i].center.y;
+                block.cz[i] = spheres[start + i].center.z;
+                block.radius[i] = spheres[start + i].radius;
+            }
+            nodes[index].is_leaf = 1;
+            nodes[index].offset = static_cast<uint32_t>(blocks.size());
+            blocks.push_back(block);
+            return index;
+        }
+
+        Vec3 extent = centroid_bounds.max - centroid_bounds.min;
+        int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+        // Split on a block boundary so leaves stay full.
+        size_t mid = start + std::max<size_t>(kBlockWidth, (count / 2) / kBlockWidth * kBlockWidth);
+        std::nth_element(spheres.begin() + static_cast<long>(start), spheres.begin() + static_cast<long>(mid),
+                         spheres.begin() + static_cast<long>(end),
+                         [axis](const SphereInstance &a, const SphereInstance &b)
+                         { return a.center[axis] < b.center[axis]; });
+
+        BuildNode(spheres, start, mid);
+        nodes[index].offset = BuildNode(spheres, mid, end);
+        return index;
+    }
+};
+
+inline void CollectSpheres(const std::vector<HittablePtr> &objects, std::vector<SphereInstance> &out_spheres)
+{
+    for (const auto &obj : objects)
+    {
+        if (const auto *set = dynamic_cast<const SphereSet *>(obj.get()))
+        {
+            set->ForEachSphere([&](const SphereInstance &s) { out_spheres.push_back(s); });
+        }
+    }
+}
+
+// Loads a point cloud as spheres. ".xyz"/".txt" files are text with one
+// "x y z [radius]" point per line; anything else is binary: the magic
+// "SPH1", a uint64 count, then count records of float32 x, y, z, radius.
+// Points without a radius (or with radius <= 0) use default_radius.
+inline bool LoadPointCloud(const char *path,
+                           const Vec3 &offset,
+                           float scale,
+                           float default_radius,
+                           std::vector<SphereInstance> &out_spheres)
+{
+    std::FILE *file = std::fopen(path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    auto add_point = [&](float x, float y, float z, float r)
+    {
+        float radius = r > 0.0f ? r : default_radius;
+        out_spheres.push_back(SphereInstance{Vec3{x, y, z} * scale + offset, radius * scale});
+    };
+
+    std::string name = path;
+    size_t dot = name.rfind('.');
+    std::string ext = dot == std::string::npos ? std::string() : name.substr(dot);
+    bool ok = true;
+    if (ext == ".xyz" || ext == ".txt")
+    {
+        char line[256];
+        while (std::fgets(line, sizeof(line), file))
+        {
+            char *cursor = line;
+            char *next = nullptr;
+            float values[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            int parsed = 0;
+            for (; parsed < 4; ++parsed)
+            {
+                values[parsed] = std::strtof(cursor, &next);
+                if (next == cursor)
+                {
+                    break;
+                }
+                cursor = next;
+            }
+            if (parsed >= 3)
+            {
+                add_point(values[0], values[1], values[2], parsed == 4 ? values[3] : 0.0f);
+            }
+        }
+    }
+    else
+    {
+        char magic[4];
+        uint64_t count = 0;
+        ok = std::fread(magic, 1, 4, file) == 4 && std::memcmp(magic, "SPH1", 4) == 0 &&
+             std::fread(&count, sizeof(count), 1, file) == 1;
+        std::vector<float> chunk(4 * 65536);
+        while (ok && count > 0)
+        {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(count, 65536));
+            size_t got = std::fread(chunk.data(), sizeof(float) * 4, want, file);
+            for (size_t i = 0; i < got; ++i)
+            {
+                add_point(chunk[i * 4], chunk[i * 4 + 1], chunk[i * 4 + 2], chunk[i * 4 + 3]);
+            }
+            ok = got == want;
+            count -= got;
+        }
+    }
+
+    std::fclose(file);
+    return ok;
+}
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped timing zones written as Chrome Trace Event JSON (chrome://tracing,
+// ui.perfetto.dev). Zones and thread names cost one relaxed load (plus a
+// thread_local store for names) unless a capture is running. Each thread
+// records into its own ring buffer, taken from a pool on its first recorded
+// event and returned when the thread exits, so the per-frame render threads
+// reuse a stable set of timeline rows instead of adding one per frame.
+
+struct TraceEvent
+{
+    const char *name = nullptr;
+    int64_t start_ns = 0;
+    int64_t duration_ns = 0;
+};
+
+// Single-producer ring: only the thread holding the ring's lease (or, for
+// named rows, the one thread that feeds them) pushes, without locking. The
+// tracer reads it only between captures; past kCapacity events the oldest
+// are overwritten.
+struct TraceRing
+{
+    static constexpr uint64_t kCapacity = 1 << 14;
+
+    std::unique_ptr<TraceEvent[]> events = std::make_unique<TraceEvent[]>(kCapacity);
+    std::atomic<uint64_t> head{0};
+    // First event of the current capture; touched only under the tracer mutex.
+    uint64_t begin = 0;
+    int id = 0;
+    std::string thread_name;
+
+    void Push(const TraceEvent &event)
+    {
+        uint64_t index = head.load(std::memory_order_relaxed);
+        events[index % kCapacity] = event;
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    void Clear()
+    {
+        begin = head.load(std::memory_order_acquire);
+    }
+
+    uint64_t First(uint64_t end) const
+    {
+        return std::max(begin, end > kCapacity ? end - kCapacity : 0);
+    }
+};
+
+struct Tracer
+{
+    static Tracer &Get()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    bool Enabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    int64_t NowNs() const
+    {
+        return ToNs(std::chrono::steady_clock::now());
+    }
+
+    int64_t ToNs(std::chrono::steady_clock::time_point time) const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch).count();
+    }
+
+    // Starts recording and clears earlier events; the capture stops by itself
+    // after frame_count calls to EndFrame.
+    void BeginCapture(int frame_count)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &ring : rings)
+        {
+            ring->Clear();
+        }
+        for (const auto &ring : named_rings)
+        {
+            ring->Clear();
+        }
+        frames_left = std::max(1, frame_count);
+        enabled.store(true, std::memory_order_relaxed);
+    }
+
+    // Marks the end of a frame. Returns true on the frame that completes the
+    // capture; the events are then ready for WriteChromeTrace.
+    bool EndFrame()
+    {
+        if (!Enabled())
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--frames_left > 0)
+        {
+            return false;
+        }
+        enabled.store(false, std::memory_order_relaxed);
+        return true;
+    }
+
+    // The calling thread's ring, acquired on first use under the name given
+    // to SetThreadName.
+    TraceRing &ThreadRing()
+    {
+        RingLease &lease = ThreadLease();
+        if (!lease.ring)
+        {
+            lease.ring = Acquire(lease.name);
+        }
+        return *lease.ring;
+    }
+
+    // A timeline row that isn't tied to a thread, e.g. one per remote worker.
+    // Rows are looked up by name and live as long as the tracer.
+    TraceRing &NamedRing(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &ring : named_rings)
+        {
+            if (ring->thread_name == name)
+            {
+                return *ring;
+            }
+        }
+        named_rings.push_back(NewRing());
+        named_rings.back()->thread_name = name;
+        return *named_rings.back();
+    }
+
+    // Names the calling thread's row; threads with the same role land on the
+    // same pooled rows frame after frame. Only remembered here: the row is
+    // taken when the thread records its first event.
+    void SetThreadName(const char *name)
+    {
+        RingLease &lease = ThreadLease();
+        lease.name = name;
+        if (lease.ring && lease.ring->thread_name != name)
+        {
+            Release(lease.ring);
+            lease.ring = nullptr;
+        }
+    }
+
+    bool WriteChromeTrace(const char *path, size_t *out_event_count = nullptr)
+    {
+        std::FILE *file = std::fopen(path, "w");
+        if (!file)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t written = 0;
+        std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"raytracer\"}}");
+        auto write_ring = [&](TraceRing &ring, bool numbered)
+        {
+            uint64_t end = ring.head.load(std::memory_order_acquire);
+            uint64_t first = ring.First(end);
+            if (first == end)
+            {
+                return;
+            }
+            std::string label = ring.thread_name.empty() ? "thread" : ring.thread_name;
+            std::replace(label.begin(), label.end(), '"', '\'');
+            std::replace(label.begin(), label.end(), '\\', '/');
+            if (numbered)
+            {
+                label += " " + std::to_string(ring.id);
+            }
+            std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                         ring.id, label.c_str());
+            for (uint64_t i = first; i < end; ++i)
+            {
+                const TraceEvent &event = ring.events[i % TraceRing::kCapacity];
+                std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                             event.name, ring.id, static_cast<double>(event.start_ns) / 1000.0,
+                             static_cast<double>(event.duration_ns) / 1000.0);
+            }
+            written += static_cast<size_t>(end - first);
+            uint64_t dropped = first - ring.begin;
+            if (dropped > 0)
+            {
+                std::fprintf(file, ",\n{\"name\":\"ring overflow: %llu events dropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":0}",
+                             static_cast<unsigned long long>(dropped), ring.id);
+            }
+        };
+        for (const auto &ring : rings)
+        {
+            write_ring(*ring, true);
+        }
+        for (const auto &ring : named_rings)
+        {
+            write_ring(*ring, false);
+        }
+        std::fprintf(file, "\n]}\n");
+        bool ok = std::fclose(file) == 0;
+        if (out_event_count)
+        {
+            *out_event_count = written;
+        }
+        return ok;
+    }
+
+private:
+    struct RingLease
+    {
+        TraceRing *ring = nullptr;
+        const char *name = "";
+
+        ~RingLease()
+        {
+            if (ring)
+            {
+                Tracer::Get().Release(ring);
+            }
+        }
+    };
+
+    Tracer() : epoch(std::chrono::steady_clock::now()) {}
+
+    static RingLease &ThreadLease()
+    {
+        thread_local RingLease lease;
+        return lease;
+    }
+
+    TraceRing *Acquire(const char *name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < free_pool.size(); ++i)
+        {
+            if (free_pool[i]->thread_name == name)
+            {
+                TraceRing *ring = free_pool[i];
+                free_pool.erase(free_pool.begin() + static_cast<long>(i));
+                return ring;
+            }
+        }
+        rings.push_back(NewRing());
+        rings.back()->thread_name = name;
+        return rings.back().get();
+    }
+
+    std::unique_ptr<TraceRing> NewRing()
+    {
+        auto ring = std::make_unique<TraceRing>();
+        ring->id = ++ring_count;
+        return ring;
+    }
+
+    // Events stay in the ring for the next capture dump; only ownership
+    // returns to the pool.
+    void Release(TraceRing *ring)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_pool.push_back(ring);
+    }
+
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point epoch;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceRing>> rings;
+    std::vector<std::unique_ptr<TraceRing>> named_rings;
+    std::vector<TraceRing *> free_pool;
+    int ring_count = 0;
+    int frames_left = 0;
+};
+
+// Records the enclosing scope as one zone. name must outlive the capture
+// (normally a string literal).
+struct TraceZone
+{
+    explicit TraceZone(const char *name)
+    {
+        if (Tracer::Get().Enabled())
+        {
+            zone_name = name;
+            start_ns = Tracer::Get().NowNs();
+        }
+    }
+
+    TraceZone(const TraceZone &) = delete;
+    TraceZone &operator=(const TraceZone &) = delete;
+
+    ~TraceZone()
+    {
+        End();
+    }
+
+    // Closes the zone before the end of the scope. Zones still open when the
+    // capture stops are dropped, so rings aren't written while being read.
+    void End()
+    {
+        if (zone_name)
+        {
+            Tracer &tracer = Tracer::Get();
+            if (tracer.Enabled())
+            {
+                tracer.ThreadRing().Push(TraceEvent{zone_name, start_ns, tracer.NowNs() - start_ns});
+            }
+            zone_name = nullptr;
+        }
+    }
+
+private:
+    const char *zone_name = nullptr;
+    int64_t start_ns = 0;
+};
+
+// Names the calling thread's timeline row. name must outlive the thread
+// (normally a string literal).
+inline void TraceThreadName(const char *name)
+{
+    Tracer::Get().SetThreadName(name);
+}
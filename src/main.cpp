@@ -4,34 +4,115 @@
 #include "rlImGui.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "BVH.h"
 #include "Camera.h"
+#include "CameraPath.h"
+#include "CompactBVH.h"
+#include "CpuDispatch.h"
+#include "Distributed.h"
+#include "MeshAccel.h"
 #include "MeshLoader.h"
+#include "MeshSimplify.h"
 #include "Renderer.h"
+#include "SequenceRenderer.h"
 #include "Sphere.h"
+#include "SphereSet.h"
+#include "Trace.h"
 #include "Vec3.h"
 
-int main()
-{
-    int screen_width = 1280;
-    int screen_height = 720;
-
-    SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_WINDOW_RESIZABLE);
-    InitWindow(screen_width, screen_height, "Ray Tracer Visualizer");
-    SetTargetFPS(60);
-
-    rlImGuiSetup(true);
-    ImGui::StyleColorsDark();
+// Placement for loaded models and point clouds, shared by the panel defaults
+// and sequence mode so both frame them the same way.
+constexpr Vec3 kDefaultModelOffset{0.0f, -1.0f, 0.0f};
+constexpr float kDefaultModelScale = 1.0f;
+constexpr float kDefaultPointRadius = 0.02f;
 
-    RenderTexture2D render_target = LoadRenderTexture(screen_width, screen_height);
-    Image cpu_image = GenImageColor(screen_width, screen_height, BLACK);
-    Texture2D cpu_texture = LoadTextureFromImage(cpu_image);
-    UnloadImage(cpu_image);
+int main(int argc, char **argv)
+{
+    std::string worker_address;
+    std::vector<std::string> worker_addresses;
+    int turntable_frames = 0;
+    std::string camera_path_file;
+    std::string sequence_dir = "frames";
+    std::string sequence_obj;
+    std::string sequence_points;
+    int sequence_width = 1280;
+    int sequence_height = 720;
+    int trace_frames = 0;
+    std::string trace_path = "trace.json";
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--worker") == 0 && i + 1 < argc)
+        {
+            worker_address = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+        {
+            worker_addresses = SplitAddressList(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--turntable") == 0 && i + 1 < argc)
+        {
+            turntable_frames = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc)
+        {
+            camera_path_file = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            sequence_dir = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--obj") == 0 && i + 1 < argc)
+        {
+            sequence_obj = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--points") == 0 && i + 1 < argc)
+        {
+            sequence_points = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+        {
+            const char *size = argv[++i];
+            char trailing = 0;
+            if (std::sscanf(size, "%dx%d%c", &sequence_width, &sequence_height, &trailing) != 2 ||
+                sequence_width <= 0 || sequence_height <= 0)
+            {
+                std::fprintf(stderr, "invalid --size %s\nusage: --size WIDTHxHEIGHT (e.g. 1280x720)\n", size);
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--trace-frames") == 0 && i + 1 < argc)
+        {
+            trace_frames = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--trace-out") == 0 && i + 1 < argc)
+        {
+            trace_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--isa") == 0 && i + 1 < argc)
+        {
+            CpuIsa isa;
+            const char *name = argv[++i];
+            if (!ParseCpuIsa(name, isa) || !SetCpuIsa(isa))
+            {
+                std::fprintf(stderr, "ISA %s is not available, using %s\n", name, CpuIsaName(ActiveCpuIsa()));
+            }
+        }
+    }
 
-    std::vector<Color> pixels;
-    pixels.resize(static_cast<size_t>(screen_width * screen_height));
+    if (!worker_address.empty())
+    {
+        return RunTileWorker(worker_address, std::max(1u, std::thread::hardware_concurrency()));
+    }
 
     OrbitCamera camera;
     camera.yaw = camera.yaw_target = 0.6f;
@@ -50,15 +131,225 @@ int main()
     params.metallic = 0.05f;
     params.debug_normals = false;
 
+    if (turntable_frames > 0 || !camera_path_file.empty())
+    {
+        CameraPath path = CameraPath::Turntable(turntable_frames, camera.yaw, camera.pitch, camera.distance);
+        if (!camera_path_file.empty() && !LoadCameraPath(camera_path_file.c_str(), path))
+        {
+            std::fprintf(stderr, "cannot read camera path %s\n", camera_path_file.c_str());
+            return 1;
+        }
+
+        // Model loading goes through raylib and needs a GL context, so open a hidden window.
+        SetConfigFlags(FLAG_WINDOW_HIDDEN);
+        InitWindow(sequence_width, sequence_height, "Ray Tracer Sequence");
+        std::vector<HittablePtr> sequence_objects;
+        std::vector<Vec3> positions;
+        if (!sequence_obj.empty())
+        {
+            if (!LoadObjPositions(sequence_obj.c_str(), kDefaultModelOffset, kDefaultModelScale, positions) ||
+                positions.empty())
+            {
+                std::fprintf(stderr, "cannot read model %s\n", sequence_obj.c_str());
+                CloseWindow();
+                return 1;
+            }
+            AppendCompactMesh(positions, sequence_objects);
+        }
+        std::vector<SphereInstance> spheres;
+        if (!sequence_points.empty())
+        {
+            if (!LoadPointCloud(sequence_points.c_str(), kDefaultModelOffset, kDefaultModelScale, kDefaultPointRadius,
+                                spheres))
+            {
+                std::fprintf(stderr, "cannot read point cloud %s\n", sequence_points.c_str());
+                CloseWindow();
+                return 1;
+            }
+            sequence_objects.push_back(std::make_shared<SphereSet>(std::move(spheres)));
+        }
+
+        // A trace covers the whole sequence as one capture.
+        TraceThreadName("main");
+        if (trace_frames > 0)
+        {
+            Tracer::Get().BeginCapture(1);
+        }
+        SequenceStats stats = RenderSequence(path, camera, params, sequence_objects, sequence_width, sequence_height,
+                                             sequence_dir, std::max(1u, std::thread::hardware_concurrency()));
+        stats.Print();
+        if (Tracer::Get().EndFrame() && !Tracer::Get().WriteChromeTrace(trace_path.c_str()))
+        {
+            std::fprintf(stderr, "cannot write trace %s\n", trace_path.c_str());
+        }
+        CloseWindow();
+        return stats.failed_writes > 0 ? 1 : 0;
+    }
+
+    int screen_width = 1280;
+    int screen_height = 720;
+
+    SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_WINDOW_RESIZABLE);
+    InitWindow(screen_width, screen_height, "Ray Tracer Visualizer");
+    SetTargetFPS(60);
+
+    rlImGuiSetup(true);
+    ImGui::StyleColorsDark();
+
+    RenderTexture2D render_target = LoadRenderTexture(screen_width, screen_height);
+    Image cpu_image = GenImageColor(screen_width, screen_height, BLACK);
+    Texture2D cpu_texture = LoadTextureFromImage(cpu_image);
+    UnloadImage(cpu_image);
+
+    std::vector<Color> pixels;
+    pixels.resize(static_cast<size_t>(screen_width * screen_height));
+
+    // Extra objects handed to the renderer: the loaded model plus the point cloud.
+    std::vector<HittablePtr> scene_objects;
     std::vector<HittablePtr> model_objects;
-    Vec3 model_offset{0.0f, -1.0f, 0.0f};
-    float model_scale = 1.0f;
+    Vec3 model_offset = kDefaultModelOffset;
+    float model_scale = kDefaultModelScale;
     char model_path[256] = "assets/model.obj";
+    uint64_t model_version = 0;
+    int mesh_accel = 1;
+    size_t model_triangle_count = 0;
+    size_t model_accel_bytes = 0;
+    double model_load_ms = 0.0;
+    double model_first_frame_ms = 0.0;
+    bool timing_first_frame = false;
+    std::vector<MeshLod> model_lods;
+    // Scene objects with a coarser level in place of the model, indexed like
+    // model_lods (entry 0 stays empty; level 0 is scene_objects).
+    std::vector<std::vector<HittablePtr>> lod_scene_objects;
+    // Coarse levels are simplified in the background; the full mesh renders
+    // until they arrive. Builds for models that were replaced are cancelled
+    // and kept here until they finish.
+    std::future<std::vector<MeshLod>> lod_build;
+    std::shared_ptr<std::atomic<bool>> lod_build_cancel;
+    std::vector<std::future<std::vector<MeshLod>>> retired_lod_builds;
+    bool auto_lod = true;
+    int preview_lod = 2;
+    int active_lod = 0;
+    double pointer_mrays = 0.0;
+    double compact_mrays = 0.0;
+
+    std::shared_ptr<SphereSet> point_cloud;
+    char points_path[256] = "assets/points.xyz";
+    float point_radius = kDefaultPointRadius;
+    double points_load_ms = 0.0;
+    std::string points_status;
+    // Bumped whenever scene_objects or lod_scene_objects change.
+    uint64_t scene_version = 0;
+
+    // Coarse-level scene lists only feed the local renderer, so they don't
+    // bump model_version (which would resend the mesh to workers).
+    auto refresh_lod_objects = [&]()
+    {
+        ++scene_version;
+        lod_scene_objects.assign(model_lods.size(), {});
+        for (size_t level = 1; level < model_lods.size(); ++level)
+        {
+            lod_scene_objects[level] = model_lods[level].objects;
+            if (point_cloud)
+            {
+                lod_scene_objects[level].push_back(point_cloud);
+            }
+        }
+    };
+
+    auto refresh_scene_objects = [&]()
+    {
+        scene_objects = model_objects;
+        if (point_cloud)
+        {
+            scene_objects.push_back(point_cloud);
+        }
+        refresh_lod_objects();
+        ++model_version;
+    };
+
+    auto cancel_lod_build = [&]()
+    {
+        if (lod_build.valid())
+        {
+            lod_build_cancel->store(true, std::memory_order_relaxed);
+            retired_lod_builds.push_back(std::move(lod_build));
+        }
+    };
+
+    auto load_model = [&]()
+    {
+        cancel_lod_build();
+        model_objects.clear();
+        model_lods.clear();
+        model_triangle_count = 0;
+        model_accel_bytes = 0;
+        double start = GetTime();
+        std::vector<Vec3> positions;
+        if (LoadObjPositions(model_path, model_offset, model_scale, positions) && !positions.empty())
+        {
+            MeshAccel accel = MeshAccel::Compact;
+            MeshAccelFromIndex(mesh_accel, accel);
+            model_lods.push_back(BuildMeshLod(positions, accel));
+            // Simplifying reads every triangle, which the lazy BVH exists to avoid.
+            if (accel != MeshAccel::Lazy)
+            {
+                lod_build_cancel = std::make_shared<std::atomic<bool>>(false);
+                lod_build = std::async(std::launch::async,
+                                       [positions = std::move(positions), accel, cancel = lod_build_cancel]()
+                                       { return BuildCoarseMeshLods(positions, accel, 3, cancel.get()); });
+            }
+        }
+        if (!model_lods.empty())
+        {
+            model_objects = model_lods[0].objects;
+            model_triangle_count = model_lods[0].triangles;
+            model_accel_bytes = model_lods[0].accel_bytes;
+        }
+        model_load_ms = (GetTime() - start) * 1000.0;
+        timing_first_frame = true;
+        refresh_scene_objects();
+    };
 
     unsigned int thread_count = std::max(1u, std::thread::hardware_concurrency());
 
+    TileCoordinator coordinator;
+    bool use_distributed = !worker_addresses.empty();
+    if (use_distributed)
+    {
+        coordinator.Connect(worker_addresses);
+    }
+
+    double frame_ms = 0.0;
+    bool raster_primary = false;
+    bool ui_dragging = false;
+    HybridScene hybrid_scene;
+    // What hybrid_scene was built from; it is rebuilt only when these change.
+    const std::vector<HittablePtr> *hybrid_objects = nullptr;
+    uint64_t hybrid_scene_version = 0;
+    Sphere hybrid_sphere;
+    int ui_turntable_frames = 120;
+    char ui_sequence_dir[256] = "frames";
+    SequenceStats last_sequence;
+    // The turntable renders on its own thread against a snapshot of the
+    // scene; the viewport pauses meanwhile so the sequence gets the cores.
+    std::future<SequenceStats> sequence_job;
+    auto sequence_progress = std::make_shared<SequenceProgress>();
+    int ui_trace_frames = std::max(1, trace_frames > 0 ? trace_frames : 5);
+    char ui_trace_path[256];
+    std::snprintf(ui_trace_path, sizeof(ui_trace_path), "%s", trace_path.c_str());
+    std::string trace_status;
+    bool trace_requested = trace_frames > 0;
+    TraceThreadName("main");
+
     while (!WindowShouldClose())
     {
+        if (trace_requested)
+        {
+            Tracer::Get().BeginCapture(ui_trace_frames);
+            trace_requested = false;
+        }
+        TraceZone frame_zone("frame");
         float dt = GetFrameTime();
 
         if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT))
@@ -75,6 +366,38 @@ int main()
         camera.ClampTargets();
         camera.SmoothStep(dt);
 
+        if (lod_build.valid() && lod_build.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            for (MeshLod &lod : lod_build.get())
+            {
+                model_lods.push_back(std::move(lod));
+            }
+            refresh_lod_objects();
+        }
+        retired_lod_builds.erase(std::remove_if(retired_lod_builds.begin(), retired_lod_builds.end(),
+                                                [](const std::future<std::vector<MeshLod>> &build)
+                                                {
+                                                    return build.wait_for(std::chrono::seconds(0)) ==
+                                                           std::future_status::ready;
+                                                }),
+                                 retired_lod_builds.end());
+
+        // Coarse model while the view is changing (camera motion or a panel
+        // slider being dragged last frame); full detail once it settles.
+        bool camera_moving = IsMouseButtonDown(MOUSE_BUTTON_RIGHT) || wheel != 0.0f ||
+                             std::abs(camera.yaw_target - camera.yaw) > 1e-3f ||
+                             std::abs(camera.pitch_target - camera.pitch) > 1e-3f ||
+                             std::abs(camera.distance_target - camera.distance) > 1e-3f;
+        bool interacting = camera_moving || ui_dragging;
+        active_lod = 0;
+        if (auto_lod && interacting && model_lods.size() > 1)
+        {
+            active_lod = std::clamp(preview_lod, 1, static_cast<int>(model_lods.size()) - 1);
+        }
+        // Workers keep full detail: switching levels would resend the mesh.
+        const std::vector<HittablePtr> &frame_objects =
+            active_lod > 0 && !use_distributed ? lod_scene_objects[active_lod] : scene_objects;
+
         if (IsWindowResized())
         {
             screen_width = GetScreenWidth();
@@ -88,8 +411,48 @@ int main()
             pixels.resize(static_cast<size_t>(screen_width * screen_height));
         }
 
-        RenderScene(pixels, screen_width, screen_height, camera, params, model_objects, thread_count);
-        UpdateTexture(cpu_texture, pixels.data());
+        if (sequence_job.valid() && sequence_job.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            last_sequence = sequence_job.get();
+            last_sequence.Print();
+        }
+        bool sequence_running = sequence_job.valid();
+
+        TraceZone render_zone("render");
+        double render_start = GetTime();
+        // While a turntable renders the viewport keeps its last image.
+        bool rendered = sequence_running ||
+                        (use_distributed && coordinator.RenderFrame(pixels, screen_width, screen_height, camera,
+                                                                    params, scene_objects, model_version,
+                                                                    thread_count));
+        if (!rendered && raster_primary)
+        {
+            if (hybrid_objects != &frame_objects || hybrid_scene_version != scene_version ||
+                hybrid_sphere.radius != params.sphere.radius || hybrid_sphere.center.x != params.sphere.center.x ||
+                hybrid_sphere.center.y != params.sphere.center.y || hybrid_sphere.center.z != params.sphere.center.z)
+            {
+                BuildHybridScene(params, frame_objects, hybrid_scene);
+                hybrid_objects = &frame_objects;
+                hybrid_scene_version = scene_version;
+                hybrid_sphere = params.sphere;
+            }
+            RenderHybridFrame(pixels, screen_width, screen_height, camera, params, hybrid_scene, thread_count);
+        }
+        else if (!rendered)
+        {
+            RenderScene(pixels, screen_width, screen_height, camera, params, frame_objects, thread_count);
+        }
+        frame_ms = (GetTime() - render_start) * 1000.0;
+        if (timing_first_frame)
+        {
+            model_first_frame_ms = frame_ms;
+            timing_first_frame = false;
+        }
+        render_zone.End();
+        {
+            TraceZone zone("UpdateTexture");
+            UpdateTexture(cpu_texture, pixels.data());
+        }
 
         BeginTextureMode(render_target);
         ClearBackground(BLACK);
@@ -103,10 +466,17 @@ int main()
                       -static_cast<float>(screen_height)};
         DrawTextureRec(render_target.texture, src, Vector2{0.0f, 0.0f}, WHITE);
 
+        TraceZone ui_zone("ImGui");
         rlImGuiBegin();
         ImGui::Begin("Ray Tracer Controls");
         ImGui::Text("Resolution: %dx%d", screen_width, screen_height);
         ImGui::Text("Threads: %u", thread_count);
+        int ui_isa = static_cast<int>(ActiveCpuIsa());
+        if (ImGui::Combo("Kernels", &ui_isa, "SSE2/NEON\0AVX2\0AVX-512\0"))
+        {
+            SetCpuIsa(static_cast<CpuIsa>(ui_isa));
+        }
+        ImGui::Text("Best supported: %s", CpuIsaName(DetectCpuIsa()));
         ImGui::Separator();
         ImGui::Text("Sphere");
         ImGui::SliderFloat3("Position", &params.sphere.center.x, -4.0f, 4.0f);
@@ -127,26 +497,216 @@ int main()
         ImGui::InputText("OBJ Path", model_path, sizeof(model_path));
         ImGui::SliderFloat3("Model Offset", &model_offset.x, -5.0f, 5.0f);
         ImGui::SliderFloat("Model Scale", &model_scale, 0.1f, 5.0f);
+        ImGui::Combo("Mesh Accel", &mesh_accel, kMeshAccelComboItems);
         if (ImGui::Button("Load OBJ"))
         {
-            model_objects.clear();
-            LoadObjAsTriangles(model_path, model_offset, model_scale, model_objects);
+            load_model();
         }
         ImGui::SameLine();
         if (ImGui::Button("Clear Model"))
         {
+            cancel_lod_build();
             model_objects.clear();
+            model_lods.clear();
+            model_triangle_count = 0;
+            model_accel_bytes = 0;
+            refresh_scene_objects();
+        }
+        if (model_triangle_count > 0)
+        {
+            size_t pointer_bytes = EstimateBVHBytes(model_triangle_count, sizeof(Triangle));
+            ImGui::Text("Triangles: %zu, load + build: %.0f ms, first frame: %.0f ms", model_triangle_count,
+                        model_load_ms, model_first_frame_ms);
+            // Pointer and lazy sizes are estimates; compact BVH sizes are exact.
+            ImGui::Text("Accel memory: %s%.1f MB (pointer BVH estimate ~%.1f MB)",
+                        model_lods[0].accel_bytes_estimated ? "~" : "", model_accel_bytes / 1048576.0,
+                        pointer_bytes / 1048576.0);
+            for (size_t level = 0; level < model_lods.size(); ++level)
+            {
+                const MeshLod &lod = model_lods[level];
+                ImGui::Text("%sLOD %zu: %zu tris, simplify %.0f ms, build %.1f ms, %s%.1f MB",
+                            static_cast<int>(level) == active_lod ? "> " : "  ", level, lod.triangles,
+                            lod.simplify_ms, lod.build_ms, lod.accel_bytes_estimated ? "~" : "",
+                            lod.accel_bytes / 1048576.0);
+                const auto *lazy = lod.objects.empty() ? nullptr : dynamic_cast<const LazyBVH *>(lod.objects[0].get());
+                if (lazy)
+                {
+                    ImGui::Text("    lazy subtrees built: %zu / %zu",
+                                lazy->built_subtrees.load(std::memory_order_relaxed), lazy->lazy_subtrees);
+                }
+            }
+            if (lod_build.valid())
+            {
+                ImGui::Text("  building coarser LODs...");
+            }
+            ImGui::Checkbox("Coarse LOD While Moving", &auto_lod);
+            if (model_lods.size() > 1)
+            {
+                ImGui::SliderInt("Moving LOD", &preview_lod, 1, static_cast<int>(model_lods.size()) - 1);
+            }
+            if (ImGui::Button("Benchmark Accel"))
+            {
+                std::vector<Vec3> positions;
+                CollectTrianglePositions(model_objects, positions);
+                std::vector<HittablePtr> triangles = MakeTriangles(positions);
+                HittablePtr pointer_root = BuildBVH(triangles, 0, triangles.size());
+                CompactBVH compact_root(positions);
+                pointer_mrays = MeasureRaysPerSecond(*pointer_root, camera, 320, 180) / 1e6;
+                compact_mrays = MeasureRaysPerSecond(compact_root, camera, 320, 180) / 1e6;
+            }
+            if (pointer_mrays > 0.0)
+            {
+                ImGui::Text("Primary rays: pointer %.2f, compact %.2f Mray/s (%+.0f%%)",
+                            pointer_mrays, compact_mrays, (compact_mrays / pointer_mrays - 1.0) * 100.0);
+            }
+        }
+        ImGui::Separator();
+        ImGui::Text("Point Cloud (.xyz text or SPH1 binary)");
+        ImGui::InputText("Points Path", points_path, sizeof(points_path));
+        ImGui::SliderFloat("Point Radius", &point_radius, 0.001f, 0.2f);
+        if (ImGui::Button("Load Points"))
+        {
+            double start = GetTime();
+            std::vector<SphereInstance> spheres;
+            point_cloud.reset();
+            points_status.clear();
+            if (LoadPointCloud(points_path, model_offset, model_scale, point_radius, spheres))
+            {
+                point_cloud = std::make_shared<SphereSet>(std::move(spheres));
+            }
+            else
+            {
+                // Missing file, bad header or a truncated binary body.
+                points_status = std::string("Cannot read ") + points_path;
+            }
+            points_load_ms = (GetTime() - start) * 1000.0;
+            refresh_scene_objects();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear Points"))
+        {
+            point_cloud.reset();
+            points_status.clear();
+            refresh_scene_objects();
+        }
+        if (!points_status.empty())
+        {
+            ImGui::Text("%s", points_status.c_str());
+        }
+        if (point_cloud)
+        {
+            ImGui::Text("Spheres: %zu, load + build: %.0f ms, %.1f MB",
+                        point_cloud->sphere_count, points_load_ms, point_cloud->MemoryBytes() / 1048576.0);
+        }
+        if (!worker_addresses.empty())
+        {
+            ImGui::Separator();
+            ImGui::Text("Distributed");
+            ImGui::Checkbox("Render on Workers", &use_distributed);
+            ImGui::Text("Workers: %zu / %zu alive", coordinator.AliveWorkers(), worker_addresses.size());
+            ImGui::Text("Tiles re-issued: %d, rendered locally: %d",
+                        coordinator.tiles_reissued, coordinator.tiles_rendered_locally);
+            if (ImGui::Button("Reconnect Workers"))
+            {
+                coordinator.Connect(worker_addresses);
+            }
+        }
+        ImGui::Separator();
+        ImGui::Text("Turntable");
+        ImGui::InputInt("Frames", &ui_turntable_frames);
+        ImGui::InputText("Output Dir", ui_sequence_dir, sizeof(ui_sequence_dir));
+        if (sequence_job.valid())
+        {
+            int done = sequence_progress->frames_done.load(std::memory_order_relaxed);
+            int total = std::max(1, sequence_progress->frame_count.load(std::memory_order_relaxed));
+            char overlay[32];
+            std::snprintf(overlay, sizeof(overlay), "%d / %d", done, total);
+            ImGui::ProgressBar(static_cast<float>(done) / total, ImVec2(-1.0f, 0.0f), overlay);
+            if (ImGui::Button("Cancel Turntable"))
+            {
+                sequence_progress->cancel.store(true, std::memory_order_relaxed);
+            }
+        }
+        else if (ImGui::Button("Render Turntable"))
+        {
+            CameraPath path = CameraPath::Turntable(ui_turntable_frames, camera.yaw, camera.pitch, camera.distance);
+            sequence_progress = std::make_shared<SequenceProgress>();
+            sequence_job = std::async(std::launch::async,
+                                      [path, camera, params, objects = scene_objects, width = screen_width,
+                                       height = screen_height, dir = std::string(ui_sequence_dir), thread_count,
+                                       progress = sequence_progress]()
+                                      {
+                                          TraceThreadName("sequence");
+                                          return RenderSequence(path, camera, params, objects, width, height, dir,
+                                                                thread_count, progress.get());
+                                      });
+        }
+        if (last_sequence.cancelled)
+        {
+            ImGui::Text("Last: cancelled after %d frames", last_sequence.frames);
+        }
+        else if (last_sequence.frames > 0)
+        {
+            ImGui::Text("Last: %d frames, %.2f s, %.2f fps (%.1f ms/frame render)",
+                        last_sequence.frames, last_sequence.total_seconds, last_sequence.FramesPerSecond(),
+                        last_sequence.render_seconds * 1000.0 / last_sequence.frames);
         }
         ImGui::Separator();
         ImGui::Checkbox("Debug Normals", &params.debug_normals);
+        ImGui::Checkbox("Rasterize Primary Visibility", &raster_primary);
+        if (raster_primary)
+        {
+            const RasterStats &raster = hybrid_scene.raster_stats;
+            ImGui::Text("Raster: %zu tris, %zu tile refs, bin %.1f ms, raster %.1f ms",
+                        raster.triangles, raster.binned, raster.bin_ms, raster.raster_ms);
+        }
+        ImGui::Separator();
+        ImGui::Text("Trace (Chrome Trace Event JSON)");
+        ImGui::InputInt("Trace Frames", &ui_trace_frames);
+        ImGui::InputText("Trace File", ui_trace_path, sizeof(ui_trace_path));
+        if (Tracer::Get().Enabled())
+        {
+            ImGui::Text("Capturing...");
+        }
+        else if (ImGui::Button("Capture Trace"))
+        {
+            trace_path = ui_trace_path;
+            trace_requested = true;
+        }
+        if (!trace_status.empty())
+        {
+            ImGui::Text("%s", trace_status.c_str());
+        }
         ImGui::Text("Orbit: RMB drag, Zoom: mouse wheel");
-        ImGui::Text("FPS: %.0f", 1.0f / std::max(0.0001f, dt));
+        ImGui::Text("FPS: %.0f (render %.1f ms)", 1.0f / std::max(0.0001f, dt), frame_ms);
+        // A drag, not just an active item: typing into a text field keeps full detail.
+        ui_dragging = ImGui::IsAnyItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left);
         ImGui::End();
         rlImGuiEnd();
+        ui_zone.End();
+
+        {
+            TraceZone zone("EndDrawing");
+            EndDrawing();
+        }
 
-        EndDrawing();
+        frame_zone.End();
+        if (Tracer::Get().EndFrame())
+        {
+            size_t event_count = 0;
+            bool ok = Tracer::Get().WriteChromeTrace(trace_path.c_str(), &event_count);
+            trace_status = ok ? "Wrote " + std::to_string(event_count) + " events to " + trace_path
+                              : "Cannot write " + trace_path;
+            std::printf("%s\n", trace_status.c_str());
+        }
     }
 
+    cancel_lod_build();
+    if (sequence_job.valid())
+    {
+        sequence_progress->cancel.store(true, std::memory_order_relaxed);
+        sequence_job.wait();
+    }
     UnloadTexture(cpu_texture);
     UnloadRenderTexture(render_target);
     rlImGuiShutdown();